@@ -0,0 +1,177 @@
+/*
+ *  Allocation_accounting.cpp
+ *  BrungartV3_device
+ *
+ */
+
+#ifdef BRUNGART_ALLOCATION_ACCOUNTING
+
+#include "Allocation_accounting.h"
+
+#include <new>
+#include <atomic>
+#include <cstdlib>
+#include <cstdio>
+#if defined(__unix__) || defined(__APPLE__)
+#include <sys/resource.h>
+#include <unistd.h>
+#endif
+#ifdef __APPLE__
+#include <mach/mach.h>
+#endif
+
+// the atomic counters hold no more than the plain values, and static zero-initialization makes them ready
+// before any static constructor allocates; the phase is per thread, so one thread's phase doesn't charge another's
+struct Phase_counters {
+	std::atomic<long long> n_allocations;
+	std::atomic<long long> n_bytes;
+	std::atomic<long long> n_frees;
+};
+static Phase_counters phase_counters[Allocation_accounting::n_phases_c];
+static thread_local int current_phase = Allocation_accounting::outside_phase_c;
+
+void Allocation_accounting::set_phase(int phase)
+{
+	current_phase = (phase >= 0 && phase < n_phases_c) ? phase : outside_phase_c;
+}
+
+int Allocation_accounting::get_phase()
+{
+	return current_phase;
+}
+
+void Allocation_accounting::take_counts(Counts counts[n_phases_c])
+{
+	for(int i = 0; i < n_phases_c; i++) {
+		counts[i].n_allocations = phase_counters[i].n_allocations.exchange(0, std::memory_order_relaxed);
+		counts[i].n_bytes = phase_counters[i].n_bytes.exchange(0, std::memory_order_relaxed);
+		counts[i].n_frees = phase_counters[i].n_frees.exchange(0, std::memory_order_relaxed);
+		}
+}
+
+// the probe goes through a volatile pointer so that the compiler can't elide the pair of calls
+bool Allocation_accounting::is_counting()
+{
+	Phase_counters& counters = phase_counters[current_phase];
+	long long n_before = counters.n_allocations.load(std::memory_order_relaxed);
+	void * volatile p = ::operator new(1);
+	::operator delete(p);
+	return counters.n_allocations.load(std::memory_order_relaxed) != n_before;
+}
+
+void Allocation_accounting::record_allocation(std::size_t n_bytes)
+{
+	Phase_counters& counters = phase_counters[current_phase];
+	counters.n_allocations.fetch_add(1, std::memory_order_relaxed);
+	counters.n_bytes.fetch_add(n_bytes, std::memory_order_relaxed);
+}
+
+void Allocation_accounting::record_free()
+{
+	phase_counters[current_phase].n_frees.fetch_add(1, std::memory_order_relaxed);
+}
+
+// getrusage gives kilobytes on Linux but bytes on macOS
+long Allocation_accounting::get_peak_rss_kb()
+{
+#if defined(__unix__) || defined(__APPLE__)
+	struct rusage usage;
+	if(getrusage(RUSAGE_SELF, &usage))
+		return 0;
+#ifdef __APPLE__
+	return long(usage.ru_maxrss / 1024);
+#else
+	return long(usage.ru_maxrss);
+#endif
+#else
+	return 0;
+#endif
+}
+
+long Allocation_accounting::get_current_rss_kb()
+{
+#if defined(__APPLE__)
+	mach_task_basic_info_data_t info;
+	mach_msg_type_number_t count = MACH_TASK_BASIC_INFO_COUNT;
+	if(task_info(mach_task_self(), MACH_TASK_BASIC_INFO, reinterpret_cast<task_info_t>(&info), &count) != KERN_SUCCESS)
+		return 0;
+	return long(info.resident_size / 1024);
+#elif defined(__unix__)
+	// the second field of statm is the resident set in pages
+	FILE * statm = fopen("/proc/self/statm", "r");
+	if(!statm)
+		return 0;
+	long size_pages = 0, resident_pages = 0;
+	int n_read = fscanf(statm, "%ld %ld", &size_pages, &resident_pages);
+	fclose(statm);
+	if(n_read != 2)
+		return 0;
+	return resident_pages * (sysconf(_SC_PAGESIZE) / 1024);
+#else
+	return 0;
+#endif
+}
+
+// the replacement global allocation functions; the counting is done before the memory is touched
+
+void * operator new(std::size_t n)
+{
+	Allocation_accounting::record_allocation(n);
+	void * p = malloc(n ? n : 1);
+	if(!p)
+		throw std::bad_alloc();
+	return p;
+}
+
+void * operator new[](std::size_t n)
+{
+	return operator new(n);
+}
+
+void * operator new(std::size_t n, const std::nothrow_t&) noexcept
+{
+	Allocation_accounting::record_allocation(n);
+	return malloc(n ? n : 1);
+}
+
+void * operator new[](std::size_t n, const std::nothrow_t& nt) noexcept
+{
+	return operator new(n, nt);
+}
+
+void operator delete(void * p) noexcept
+{
+	if(!p)
+		return;
+	Allocation_accounting::record_free();
+	free(p);
+}
+
+void operator delete[](void * p) noexcept
+{
+	operator delete(p);
+}
+
+void operator delete(void * p, const std::nothrow_t&) noexcept
+{
+	operator delete(p);
+}
+
+void operator delete[](void * p, const std::nothrow_t&) noexcept
+{
+	operator delete(p);
+}
+
+#ifdef __cpp_sized_deallocation
+void operator delete(void * p, std::size_t) noexcept
+{
+	operator delete(p);
+}
+
+void operator delete[](void * p, std::size_t) noexcept
+{
+	operator delete(p);
+}
+#endif
+
+#endif
@@ -0,0 +1,74 @@
+/*
+ *  Allocation_accounting.h
+ *  BrungartV3_device
+ *
+ */
+
+#ifndef ALLOCATION_ACCOUNTING_H
+#define ALLOCATION_ACCOUNTING_H
+
+#include <cstddef>
+
+/*
+Allocation_accounting counts the device's heap allocations by phase, for finding what a long run allocates and
+whether anything grows without bound. It is compiled in only if BRUNGART_ALLOCATION_ACCOUNTING is defined, in which
+case Allocation_accounting.cpp replaces operator new and delete. The replacement is meant to bind only the code linked
+into the device plugin, so the counts cover the device's own allocations (including the library code instantiated in
+it) but not those made by the architecture or by EPICLib itself; resident memory is the only measure of the whole
+process. Allocations made inside the C++ library's own compiled functions aren't counted either, though device code
+may free them, so a net count can run slightly negative.
+
+Which operator new the plugin's calls reach is decided by the linker, not by this file:
+	macOS: the Xcode bundle is linked with the default two-level namespace, so the static linker binds the bundle's
+		own references to its own definitions; no extra setting is needed (but not with -flat_namespace).
+	ELF (Linux): the dynamic linker resolves the plugin's references to the first definition in the global scope,
+		which is the C++ library's already loaded by the host, and the counts stay at zero. Link the plugin with
+		-Wl,-Bsymbolic-functions so its references bind to its own definitions; if the host loads it RTLD_GLOBAL,
+		libraries loaded after it may bind to them too and be counted outside any device phase.
+is_counting() makes a probe allocation to check which way it went, so the device can say so instead of reporting zeros.
+Every allocation and free is charged to the current phase of the allocating thread; the device sets the phase while
+it is handling an event, and anything else is charged to outside_phase_c.
+
+The counters are atomic, so allocations on other threads are counted correctly; the phase is kept per thread.
+*/
+class Allocation_accounting {
+public:
+	static const int n_phases_c = 16;
+	static const int outside_phase_c = n_phases_c - 1;	// while no device phase is set on this thread
+	
+	struct Counts {
+		long long n_allocations;
+		long long n_bytes;
+		long long n_frees;
+	};
+
+	static void set_phase(int phase);
+	static int get_phase();
+	// copy and then zero the counts for every phase; counts made meanwhile on other threads go to the next take
+	static void take_counts(Counts counts[n_phases_c]);
+	// true if this plugin's allocations reach the replacement operator new; the probe is charged to the current phase
+	static bool is_counting();
+	
+	// resident memory in kilobytes, or 0 if the system can't say
+	static long get_peak_rss_kb();
+	static long get_current_rss_kb();
+
+	// called only by the replacement operator new and delete
+	static void record_allocation(std::size_t n_bytes);
+	static void record_free();
+};
+
+// charges allocations to a phase for as long as it exists, then restores the previous phase
+class Allocation_phase {
+public:
+	Allocation_phase(int phase) : previous_phase(Allocation_accounting::get_phase())
+		{Allocation_accounting::set_phase(phase);}
+	~Allocation_phase()
+		{Allocation_accounting::set_phase(previous_phase);}
+private:
+	int previous_phase;
+	Allocation_phase(const Allocation_phase&);
+	Allocation_phase& operator= (const Allocation_phase&);
+};
+
+#endif
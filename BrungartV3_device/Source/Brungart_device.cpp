@@ -20,6 +20,7 @@ The subject is supposed to respond to the baron phrase only. The color-digit are
 
 #include "Brungart_device.h"
 #include "Response_object.h"
+#include "Surrogate_evaluator.h"
 #include "EPICLib/Geometry.h"
 #include "EPICLib/Output_tee_globals.h"
 #include "EPICLib/Numeric_utilities.h"
@@ -35,6 +36,23 @@ The subject is supposed to respond to the baron phrase only. The color-digit are
 #include <sstream>
 #include <algorithm>
 #include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstdint>
+#include <cerrno>
+#include <atomic>
+#if defined(__unix__) || defined(__APPLE__)
+#include <unistd.h>
+#include <sys/wait.h>
+#define FORK_SERVER_AVAILABLE
+#endif
+#ifdef BRUNGART_ALLOCATION_ACCOUNTING
+#include "Allocation_accounting.h"
+// charge the allocations made while handling an event to the state the device was in
+#define ACCOUNT_ALLOCATIONS_TO_STATE Allocation_phase allocation_phase(state)
+#else
+#define ACCOUNT_ALLOCATIONS_TO_STATE
+#endif
 
 namespace GU = Geometry_Utilities;
 using namespace std;
@@ -44,10 +62,43 @@ const Symbol Fixation_point_c("Fixation_point");
 const Symbol Display_c("Display");
 const Symbol Loudspeaker_c("Loudspeaker");
 const Symbol Speaker_n_field_c("Speaker_n_field");
+const Symbol Response_timeout_c("Response_timeout");
 
 const long iti_c = 6000;	// time between response or time out and next trial start
-const long timeout_time_c = 2000;	// time between last word presentation and time-out on waiting for response
-const long response_enable_delay_time_c = 500;	// time between last word presentation and enabling responses
+const long response_enable_delay_time_c = Condition_options::response_enable_delay_time_c;
+const long n_speakers_display_time_c = 300;	// how long the number of speakers is shown
+const long fork_poll_time_c = 100;			// simulated time between a fork server's checks on its children
+const int fork_wait_poll_us_c = 10000;		// how long a check waits when no child has finished
+
+// the chance of a wrong response even at a high SNR, which caps the psychometric function below 1
+const double adaptive_lapse_rate_c = 0.02;
+// with a deadline, the fraction of it held back when planning rounds, and the fraction at which the session stops
+// during a round, leaving time to write the results
+const double deadline_planning_reserve_c = 0.1;
+const double deadline_stop_reserve_c = 0.05;
+// stratified sampling: the stimuli sampled to place the bin edges for each number of speakers and condition,
+// and the most stimuli drawn in looking for one in a trial's bin
+const int stratify_sample_size_c = 4000;
+const int max_stratum_draws_c = 10000;
+
+// seeds from the session seed, a run's identity, and an index within the run (-1 for the run as a whole),
+// so that a run's random numbers don't depend on which other runs are in the session or how many numbers they used
+void make_seeds(unsigned long seed, uint64_t identity, int index, uint32_t * seeds, int n_seeds)
+{
+	unsigned long long session_seed = seed;
+	seed_seq seq{uint32_t(session_seed), uint32_t(session_seed >> 32), uint32_t(identity), uint32_t(identity >> 32), uint32_t(index)};
+	seq.generate(seeds, seeds + n_seeds);
+}
+
+// the filename with its extension, if any, replaced by the new ending
+string replace_extension(const string& filename, const string& new_ending)
+{
+	string::size_type dot_pos = filename.find_last_of('.');
+	string::size_type slash_pos = filename.find_last_of('/');
+	if(dot_pos != string::npos && (slash_pos == string::npos || dot_pos > slash_pos))
+		return filename.substr(0, dot_pos) + new_ending;
+	return filename + new_ending;
+}
 
 const int n_outer_iterations = 6;
 const Symbol target_speaker("FS1");
@@ -57,25 +108,51 @@ const int n_inner_iterations = 6;
 const double masker_loudness = 0.; // baseline for loudness - crmstats has 60 as baseline
 
 // using 6-beat segmentation
-int message_length_c = 6;
+const int message_length_c = 6;
+const char * const default_output_filename_c = "Brungart_device_output.txt";
+const char * const default_corpus_filename_c = "crm_utterance_corpus_data.txt";
+// a corpus must have at least the talkers, callsigns, colors, and digits of the published one, since the task is
+// built on them; the extra talkers must divide equally between the genders
+const int target_callsign_index_c = 7;	// "baron"
+const unsigned long synthetic_corpus_seed_c = 1;
+const int corpus_lookup_sample_c = 100000;	// random lookups timed for the corpus report
+// the color and digit category for a trial with no response
+const int timeout_category_c = 3;
+// in the order of State_e
+const char * const state_names_c[] = {"START", "PRESENT_CURSOR", "START_TRIAL", "PRESENT_STIMULUS", 
+	"NEXT_WORD", "ENABLE_RESPONSE", "WAITING_FOR_RESPONSE", "CHANGE_N_SPEAKERS", "FORK_SERVER", "SHUTDOWN"};
+// Chrome trace tracks
+const int simulated_time_pid_c = 1;
+const int wall_clock_pid_c = 2;
+const int states_tid_c = 1;
+const int words_tid_c = 2;
+const char * const descriptor_header_c = "run\ttrial\tn_speakers\tcondition\tsnr\tk\ttrial_seed\tmodel_seed\tstart_delay\tstimulus\tcolor\tdigit\trt";
 
 
 
 Brungart_device::Brungart_device(const std::string& id, Output_tee& ot) :
-		Device_base(id, ot), n_trials(0), n_speakers(2), condition_string("4 2 rep"), 
+		Device_base(id, ot), state(START), condition_string("4 2 rep"), default_n_trials(0), n_trials(0), n_speakers(2), 
+		displayed_n_speakers(0), output_filename(default_output_filename_c), seed_specified(false), seed(0), 
+		surrogate_mode(false), fork_max_children(1), forked_job(false), next_fork_job(0), 
+		n_fork_jobs_failed(0), trial_seed(0), model_seed(0), trial_start_delay(0), 
+		seed_model_per_trial(false), replay_mode(false), replay_condition(0), replay_snr(0.), replay_k(0),
+		interleave_speakers(false), run_index(0), adaptive_snrs(false), config_hash(0), deadline_seconds(0.), round(0), 
+		n_trials_run(0), response_timeout(0), response_token(0), response_timed_out(false), stall_seconds(0.), stall_exit(false), 
+		stratify_bins(0), race_start_trials(0), race_candidate(-1),
+		trace_policy(Condition_options::TRACE_ALL), trace_interval(1), trace_snr(0.), trace_trial(false), trace_suspended(false),
+		state_entry_time(0), state_entry_wall_us(0.),
 		//stream_names(n_speakers_max_c), 
 		//speaker_genders(n_speaker_conditions_c), speaker_ids(n_speaker_conditions_c),
-		org_masking_condition_labels(n_speaker_conditions_c),masking_condition_labels(n_speaker_conditions_c),loudnesses(n_speakers_max_c, masker_loudness),
+		loudnesses(n_speakers_max_c, masker_loudness), 
+		org_masking_condition_labels(n_speaker_conditions_c),masking_condition_labels(n_speaker_conditions_c),
 		messages(n_speakers_max_c),
-		trial(0), n_completely_correct(0), n_color_only_correct(0), n_digit_only_correct(0),
-		snr_index(0), condition_index(0),
-		state(START)
+		ply_policy(Condition_options::PLY_EACH), ply_interval(0), last_cursor_update_time(0), cursor_update_pending(false), 
+		n_plies(0), n_cursor_updates(0),
+		checkpoint_interval(0), n_runs_completed(0),
+		trial(0), snr_index(0), condition_index(0)
 {
 	Assert(device_out);
 
-// cannot do this load here because the current working directory may not be set yet.
-	load_utterance_corpus_data();
-	 
 	/* Experiment Constants */
 	// rearranged to match CRM corpus conventions
 	
@@ -123,14 +200,14 @@ Talker 6	252.3	22.07	-32		5.1		f
 Talker 7	250.1	13.77	-31		4.3		f
 */
 	// speakers[0] through 3 are male, 4 through 7 are female
-	speakers.push_back(Speaker("MS1", Male_c,	121.5,  5.87,  -1, 4.5));	// 0
-	speakers.push_back(Speaker("MS2", Male_c,	129.4,  9.44,  -1, 3.4));	// 1
-	speakers.push_back(Speaker("MS3", Male_c,	127.7,  6.77,  -1, 4.3));	// 2
-	speakers.push_back(Speaker("MS4", Male_c,	132.3, 12.25,  -1, 5.2));	// 3
-	speakers.push_back(Speaker("FS1", Female_c,	258.6, 22.81,  -2, 5.5));	// 4
-	speakers.push_back(Speaker("FS2", Female_c,	248.1, 17.8,   -2, 5.1));	// 5
-	speakers.push_back(Speaker("FS3", Female_c,	252.3, 22.07,  -2, 5.1));	// 6
-	speakers.push_back(Speaker("FS4", Female_c,	250.1, 13.77,  -2, 4.3));	// 7
+	published_speakers.push_back(Speaker("MS1", Male_c,	121.5,  5.87,  -1, 4.5));	// 0
+	published_speakers.push_back(Speaker("MS2", Male_c,	129.4,  9.44,  -1, 3.4));	// 1
+	published_speakers.push_back(Speaker("MS3", Male_c,	127.7,  6.77,  -1, 4.3));	// 2
+	published_speakers.push_back(Speaker("MS4", Male_c,	132.3, 12.25,  -1, 5.2));	// 3
+	published_speakers.push_back(Speaker("FS1", Female_c,	258.6, 22.81,  -2, 5.5));	// 4
+	published_speakers.push_back(Speaker("FS2", Female_c,	248.1, 17.8,   -2, 5.1));	// 5
+	published_speakers.push_back(Speaker("FS3", Female_c,	252.3, 22.07,  -2, 5.1));	// 6
+	published_speakers.push_back(Speaker("FS4", Female_c,	250.1, 13.77,  -2, 4.3));	// 7
 	
 	// NOTE NOTE NOTE as of 5/2/12 code below does not use baseline per-speaker loudness (the -1 and -2 above).
 	
@@ -145,28 +222,15 @@ Talker 7	250.1	13.77	-31		4.3		f
 //	const double snrs[n_snrs] = {-12, -9, -6, -3, 0, +3, +6, +9, +12, +15};
 //	const double snrs[n_snrs] = {-12, -9, -6, -3, 0, +3, +6, +9, +12};
 //	const double snrs[n_snrs] = {-12, -9, -6, -3, 0, +3, +6, +9, +12};
-    // rep is the snr range in the Brungart replication experiment; org is the snr range of the original 2001 experiment
-    rep_target_snrs = {-18, -15, -12, -9, -6, -3, 0, 3, 6, 9};
-	org_target_snrs = {-12, -9, -6, -3, 0, +3, +6, +9, +12, +15};
+    // the snr ranges for rep and org are in Condition_options
 //	const double louds[n_speakers_max_c] = {masker_loudness, masker_loudness, masker_loudness, masker_loudness};
 //	copy(louds, louds+n_speakers_max_c, back_inserter(loudnesses));
 		
-	double vert_loc_start = +3.;
-	double vert_loc_inc = -2.;
-	double hor_loc_start = -7.;
-	double hor_loc_inc = +2.;
-	// create the container of search objects - always the same on each trial
-	for(int i = 0; i < 4; i++)
-		for(int j = 0; j < 8; j++) {
-			// id number is (row (i) + 1) * 10 + col (j + 1)
-			response_objects.push_back(Response_object(
-				(i+1) * 10 + j+1, 
-				GU::Point(hor_loc_start + hor_loc_inc * j, vert_loc_start + vert_loc_inc * i), 
-				colors[i],
-				digits[j])
-				);
-			}
-					
+	// the talkers, words, and response objects are fitted to the corpus
+	CRM_corpus default_corpus;
+	double load_ms = load_utterance_corpus_data(default_corpus_filename_c, default_corpus);
+	use_utterance_corpus(default_corpus, default_corpus_filename_c, load_ms);
+	
 	parse_condition_string();
 	
 //	initialize();
@@ -207,73 +271,247 @@ Digit: 8 digits, coded 0 - 7, one less than actual digit value
 
 
 
-void Brungart_device::load_utterance_corpus_data()
+// parse synthetic:<talkers>x<callsigns>x<colors>x<digits>[:<filename>]; returns false if malformed
+static bool parse_synthetic_corpus_spec(const string& spec, int dims[4], string& filename)
 {
-	ifstream infile("crm_utterance_corpus_data.txt");
-	if(!infile)
-		throw Device_exception("Could not open crm_utterance_corpus_data.txt!");
-    
-    // read, output, and discard the first line that has version information
-    getline(infile, corpus_version_info);
-	if(!infile)
-		throw Device_exception("Could not read crm_utterance_corpus_data.txt!");
-    device_out << "Corpus data version: " << corpus_version_info << endl;
-		
-	// these values are fixed in the corpus
-	for(int ispkr = 0; ispkr < 8; ispkr++) {
-		for (int icallsign = 0; icallsign < 8; icallsign++) {
-			for(int icolor = 0; icolor < 4; icolor++) {
-				for(int idigit = 0; idigit < 8; idigit++) {
-					// read and verify subscripts
-					int spk, cal, clr, dig;
-					if(!(infile >> spk >> cal >> clr >> dig))
-						throw Device_exception("failure to read utterance subscripts");
-                   // device_out << spk << ' ' << cal << ' ' << clr << ' ' << dig << endl;
-					Assert(ispkr == spk && icallsign == cal && icolor == clr && idigit == dig);
-					if(!(infile >> utterance_data[ispkr][icallsign][icolor][idigit]))
-						throw Device_exception("failure to read utterance_stats");
-						
-					if(icallsign == 7 && icolor == 3 && idigit == 7)
-						device_out << ispkr << ' ' << icallsign << ' ' << icolor << ' ' << idigit << ' '
-							<< utterance_data[ispkr][icallsign][icolor][idigit] << endl;
-					}
-				}
+	istringstream iss(spec.substr(spec.find(':') + 1));
+	char x1, x2, x3;
+	if(!(iss >> dims[0] >> x1 >> dims[1] >> x2 >> dims[2] >> x3 >> dims[3]) || x1 != 'x' || x2 != 'x' || x3 != 'x')
+		return false;
+	filename.clear();
+	if(iss.peek() == ':') {
+		iss.get();
+		getline(iss, filename);
+		return !filename.empty();
+		}
+	return iss.peek() == EOF;
+}
+
+// load the corpus named by spec, either a file or a synthetic corpus generated from the published speakers' voices, 
+// into new_corpus and return the time to read it in ms; throws Device_exception if it can't be loaded or is too small 
+// for the task, and changes nothing in the device either way
+double Brungart_device::load_utterance_corpus_data(const string& spec, CRM_corpus& new_corpus) const
+{
+	chrono::steady_clock::time_point start_time = chrono::steady_clock::now();
+	if(spec.compare(0, 10, "synthetic:") == 0) {
+		int dims[4];
+		string filename;
+		if(!parse_synthetic_corpus_spec(spec, dims, filename) || dims[0] <= 0 || dims[1] <= 0 || dims[2] <= 0 || dims[3] <= 0)
+			throw Device_exception(this, string("corpus must be <filename> or synthetic:<talkers>x<callsigns>x<colors>x<digits>[:<filename>]: ") + spec);
+		vector<CRM_corpus::Voice> voices;
+		for(int it = 0; it < dims[0]; it++) {
+			const Speaker& speaker = published_speakers[get_published_speaker(it, dims[0])];
+			voices.push_back(CRM_corpus::Voice(speaker.pitch_mean, speaker.pitch_sd, speaker.loudness_mean, speaker.loudness_sd));
+			}
+		// only reading the corpus back is timed, so the load time is that of a corpus file of this size
+		if(filename.empty()) {
+			stringstream ss;
+			CRM_corpus::write_synthetic(ss, dims[0], dims[1], dims[2], dims[3], voices, synthetic_corpus_seed_c);
+			start_time = chrono::steady_clock::now();
+			new_corpus.load(ss, spec);
 			}
+		else {
+			ofstream outfile(filename.c_str());
+			if(!outfile)
+				throw Device_exception(this, string("Could not open synthetic corpus file: ") + filename);
+			CRM_corpus::write_synthetic(outfile, dims[0], dims[1], dims[2], dims[3], voices, synthetic_corpus_seed_c);
+			outfile.close();
+			start_time = chrono::steady_clock::now();
+			new_corpus.load(filename);
+			}
+		}
+	else
+		new_corpus.load(spec);
+	double load_ms = chrono::duration<double, milli>(chrono::steady_clock::now() - start_time).count();
+	
+	if(new_corpus.get_n_talkers() < CRM_corpus::standard_n_talkers_c || new_corpus.get_n_talkers() % 2
+		|| new_corpus.get_n_callsigns() < CRM_corpus::standard_n_callsigns_c
+		|| new_corpus.get_n_colors() < CRM_corpus::standard_n_colors_c 
+		|| new_corpus.get_n_digits() < CRM_corpus::standard_n_digits_c)
+		throw Device_exception(this, string("corpus must have an even number of talkers and at least the 8 talkers, 8 callsigns, 4 colors, and 8 digits of the published corpus: ") + spec);
+	return load_ms;
+}
+
+// make a loaded corpus the current one, and fit the talkers, words, and response objects to it
+void Brungart_device::use_utterance_corpus(CRM_corpus& new_corpus, const string& spec, double load_ms)
+{
+	corpus = move(new_corpus);
+	corpus_spec = spec;
+    device_out << "Corpus data version: " << corpus.get_version_info() << endl;
+	for(int it = 0; it < CRM_corpus::standard_n_talkers_c; it++)
+		device_out << it << ' ' << 7 << ' ' << 3 << ' ' << 7 << ' ' << corpus.get(it, 7, 3, 7) << endl;
+	fit_vocabulary_to_corpus();
+	report_corpus(load_ms);
+}
+
+// the talkers in the first half are male, the rest female, as in the published corpus; talkers past those
+// get the voices of the published talkers of their gender in turn, and the words past the published ones
+// are named by their index
+void Brungart_device::fit_vocabulary_to_corpus()
+{
+	int n_talkers = corpus.get_n_talkers();
+	speakers.clear();
+	for(int it = 0; it < n_talkers; it++) {
+		bool male = it < n_talkers / 2;
+		int i = male ? it : it - n_talkers / 2;
+		Speaker speaker = published_speakers[get_published_speaker(it, n_talkers)];
+		ostringstream id;
+		id << (male ? "MS" : "FS") << i + 1;
+		speaker.id = Symbol(id.str());
+		speakers.push_back(speaker);
+		}
+	callsigns.erase(callsigns.begin() + CRM_corpus::standard_n_callsigns_c, callsigns.end());
+	for(int i = CRM_corpus::standard_n_callsigns_c; i < corpus.get_n_callsigns(); i++) {
+		ostringstream oss;
+		oss << "callsign" << i;
+		callsigns.push_back(Symbol(oss.str()));
+		}
+	colors.erase(colors.begin() + CRM_corpus::standard_n_colors_c, colors.end());
+	for(int i = CRM_corpus::standard_n_colors_c; i < corpus.get_n_colors(); i++) {
+		ostringstream oss;
+		oss << "Color" << i;
+		colors.push_back(Symbol(oss.str()));
+		}
+	digits.erase(digits.begin() + CRM_corpus::standard_n_digits_c, digits.end());
+	for(int i = CRM_corpus::standard_n_digits_c; i < corpus.get_n_digits(); i++) {
+		ostringstream oss;
+		oss << i + 1;
+		digits.push_back(Symbol(oss.str()));
+		}
+	
+	// a row for each color, a column for each digit, centered as for the published 4 x 8
+	double vert_loc_start = double(colors.size() - 1);
+	double vert_loc_inc = -2.;
+	double hor_loc_start = -double(digits.size() - 1);
+	double hor_loc_inc = +2.;
+	int row_place = 10;
+	while(row_place <= digits.size())
+		row_place *= 10;
+	// create the container of search objects - always the same on each trial
+	response_objects.clear();
+	for(int i = 0; i < colors.size(); i++)
+		for(int j = 0; j < digits.size(); j++) {
+			// id number is (row (i) + 1) * 10 + col (j + 1), with more places for the column if needed
+			response_objects.push_back(Response_object(
+				(i+1) * row_place + j+1, 
+				GU::Point(hor_loc_start + hor_loc_inc * j, vert_loc_start + vert_loc_inc * i), 
+				colors[i],
+				digits[j])
+				);
+			}
+}
+
+// the published speaker whose voice a talker has, in a corpus of n_talkers
+int Brungart_device::get_published_speaker(int talker, int n_talkers) const
+{
+	int half = n_talkers / 2;
+	return (talker < half) ? talker % 4 : 4 + (talker - half) % 4;
+}
+
+// the corpus size, the time to read it, and the mean cost of looking up an utterance at random, 
+// which grows with the corpus once it no longer fits in the caches
+void Brungart_device::report_corpus(double load_ms)
+{
+	mt19937 engine(0);
+	vector<int> indices(corpus_lookup_sample_c * 4);
+	for(int i = 0; i < corpus_lookup_sample_c; i++) {
+		indices[i * 4] = uniform_int_distribution<int>(0, corpus.get_n_talkers() - 1)(engine);
+		indices[i * 4 + 1] = uniform_int_distribution<int>(0, corpus.get_n_callsigns() - 1)(engine);
+		indices[i * 4 + 2] = uniform_int_distribution<int>(0, corpus.get_n_colors() - 1)(engine);
+		indices[i * 4 + 3] = uniform_int_distribution<int>(0, corpus.get_n_digits() - 1)(engine);
+		}
+	chrono::steady_clock::time_point start_time = chrono::steady_clock::now();
+	double total = 0.;
+	for(int i = 0; i < corpus_lookup_sample_c; i++) {
+		const CRM_utterance_stats& stats = corpus.get(indices[i * 4], indices[i * 4 + 1], indices[i * 4 + 2], indices[i * 4 + 3]);
+		total += stats.loudnesses[3] + stats.pitches[4];
 		}
+	// kept so the lookups can't be optimized away
+	volatile double lookup_total = total;
+	(void)lookup_total;
+	double lookup_ns = chrono::duration<double, nano>(chrono::steady_clock::now() - start_time).count() / corpus_lookup_sample_c;
+	device_out << "Corpus: " << corpus.get_n_talkers() << " talkers, " << corpus.get_n_callsigns() << " callsigns, " 
+		<< corpus.get_n_colors() << " colors, " << corpus.get_n_digits() << " digits; " << corpus.get_n_utterances() 
+		<< " utterances in " << corpus.get_memory_size() / 1024 << " KB, read in " << load_ms << " ms; " 
+		<< lookup_ns << " ns per lookup" << endl;
 }
 
+// the options are all checked before any is put to use, so an incorrect condition string leaves the device as it was
 void Brungart_device::parse_condition_string()
 {
-	// build an error message string in case we need it
-	string error_msg(condition_string);
-	error_msg += "\n Should be: number of trials followed by number of speakers";
-	istringstream iss(condition_string);
-	int nt;
-	iss >> nt;
-	// do all error checks before last read
-	if(!iss)
-		throw Device_exception(this, string("Incorrect condition string: ") + error_msg);
-	if(nt <= 0)
-		throw Device_exception(this, string("Number of trials must be positive: ") + error_msg);
-	int ns;
-	iss >> ns;
-	if(!iss)
-		throw Device_exception(this, string("Incorrect condition string: ") + error_msg);
-	if(ns > n_speakers_max_c || ns < 2)
-		throw Device_exception(this, string("Number of speakers must be >= 2, <=4: ") + error_msg);
-    string version;
-    iss >> version;
-	if(!iss)
-		throw Device_exception(this, string("Incorrect condition string: ") + error_msg);
-    if (version != "rep" && version != "org")
-		throw Device_exception(this, string("version must be \"rep\" or \"org\": ") + error_msg);
+	Condition_options options;
+	options.parse(condition_string);
+	// a different corpus is loaded now, so a problem with it is found before anything else is changed,
+	// and it is put to use along with the other settings
+	string cps = options.corpus_spec.empty() ? string(default_corpus_filename_c) : options.corpus_spec;
+	CRM_corpus new_corpus;
+	double corpus_load_ms = 0.;
+	if(cps != corpus_spec)
+		corpus_load_ms = load_utterance_corpus_data(cps, new_corpus);
+	// every cell with race data must be run
+	Parameter_race new_race;
+	if(!options.race_filename.empty()) {
+		vector<string> labels;
+		for(int ic = 0; ic < n_speaker_conditions_c; ic++)
+			labels.push_back(org_masking_condition_labels[ic].substr(0, 2));
+		new_race.load(options.race_filename, labels);
+		const vector<Parameter_race::Observation>& observations = new_race.get_observations();
+		const vector<int>& speaker_counts = options.speaker_counts;
+		const vector<int>& conditions = options.conditions;
+		const vector<double>& snrs = options.snrs;
+		for(int i = 0; i < observations.size(); i++) {
+			if(find(speaker_counts.begin(), speaker_counts.end(), observations[i].n_speakers) == speaker_counts.end()
+				|| find(conditions.begin(), conditions.end(), observations[i].condition_index) == conditions.end()
+				|| find(snrs.begin(), snrs.end(), observations[i].snr) == snrs.end())
+				throw Device_exception(this, string("race file has data for a cell that is not run: ") + condition_string);
+			}
+		}
 		
-	n_trials = nt;
-	n_speakers = ns;
-    if(version == "rep")
-        target_snrs = rep_target_snrs;
-    else if(version == "org")
-        target_snrs = org_target_snrs;
+	default_n_trials = options.n_trials;
+	n_trials = options.n_trials;
+	n_speakers = options.speaker_counts.front();
+	selected_speakers = options.speaker_counts;
+	interleave_speakers = options.interleave_speakers;
+	adaptive_snrs = options.adaptive_snrs;
+	target_snrs = options.snrs;
+	selected_conditions = options.conditions;
+	cell_trials = options.cell_trials;
+
+	output_filename = options.output_filename.empty() ? string(default_output_filename_c) : options.output_filename;
+	// by default the binary results go beside the text output, with the extension replaced by .cube
+	binary_output_filename = options.binary_output_filename.empty() ? 
+		replace_extension(output_filename, ".cube") : options.binary_output_filename;
+	merge_filenames = options.merge_filenames;
+	checkpoint_interval = options.checkpoint_interval;
+	seed_specified = options.seed_specified;
+	seed = options.seed;
+	surrogate_mode = options.surrogate_mode;
+	fork_jobs_filename = options.fork_jobs_filename;
+	fork_max_children = options.fork_max_children;
+	descriptors_filename = options.descriptors_filename;
+	cache_filename = options.cache_filename;
+	deadline_seconds = options.deadline_seconds;
+	chrome_trace_filename = options.chrome_trace_filename;
+	response_timeout = options.response_timeout;
+	stall_seconds = options.stall_seconds;
+	stall_exit = options.stall_exit;
+	stratify_bins = options.stratify_bins;
+	race_filename = options.race_filename;
+	race = new_race;
+	race_start_trials = options.race_start_trials;
+	ply_policy = options.ply_policy;
+	ply_interval = options.ply_interval;
+	if(cps != corpus_spec)
+		use_utterance_corpus(new_corpus, cps, corpus_load_ms);
+	seed_model_per_trial = options.seed_model_per_trial;
+	replay_mode = options.replay_mode;
+	replay_condition = options.replay_cell.condition_index;
+	replay_snr = options.replay_cell.snr;
+	replay_k = options.replay_cell.n_trials;
+	trace_policy = options.trace_policy;
+	trace_interval = options.trace_interval;
+	trace_condition = options.trace_condition;
+	trace_snr = options.trace_snr;
 }
 
 void Brungart_device::set_parameter_string(const string& condition_string_)
@@ -306,24 +544,8 @@ void Brungart_device::reset_for_run()
 {
 	// replications loop
 	trial= 0;
-	n_completely_correct = 0;
-	n_color_only_correct = 0;
-	n_digit_only_correct = 0;
-	n_completely_incorrect = 0;
-	n_masker_both = 0;
-	n_masker_color_only = 0;
-	n_masker_digit_only = 0;
-	n_masker_neither = 0;
-	n_target_color = 0;
-	n_masker_color = 0;
-	n_neither_color = 0;
-	n_target_digit = 0;
-	n_masker_digit = 0;
-	n_neither_digit = 0;
-	for(int i = 0; i < 3; i++)
-		for(int j = 0; j < 3; j++)
-			n_color_digit_table[i][j] = 0;
-
+	n_plies = 0;
+	n_cursor_updates = 0;
 }
 
 void Brungart_device::handle_Start_event()
@@ -335,66 +557,668 @@ void Brungart_device::handle_Start_event()
 void Brungart_device::handle_Stop_event()
 {
 	device_out << processor_info() << "received Stop_event" << endl;
+	stall_watchdog.stop();
+	// a trial cut short leaves its trace unwritten
+	resume_trace();
+	// finish the span for the last state
+	if(chrome_trace.is_open()) {
+		set_state(SHUTDOWN);
+		chrome_trace.close();
+		}
+	// a forked job that ends normally never gets here, so its session was stopped from outside, such as by an error
+	if(forked_job)
+		end_forked_job(EXIT_FAILURE);
 //	output_statistics();
 		
 }
 
-void Brungart_device::setup_first_run()
+// a seed for a device or fork server job that was given none; the shared global engine is left alone,
+// since devices on other threads may be using it, and each draw mixes in its own number in case
+// random_device is deterministic on this platform
+static unsigned long draw_default_seed()
 {
-	snr_index = 0;
-	condition_index = 0;
+	static atomic<unsigned long> n_seeds_drawn(0);
+	random_device rd;
+	seed_seq seq{rd(), rd(), unsigned(n_seeds_drawn++), unsigned(chrono::steady_clock::now().time_since_epoch().count())};
+	// the engines take 32-bit seeds
+	uint32_t new_seed;
+	seq.generate(&new_seed, &new_seed + 1);
+	return new_seed;
+}
+
+// returns false if there is nothing left to run because every run's results were in the cache;
+// the results have then already been written
+bool Brungart_device::setup_first_run()
+{
+	// a run without an explicit seed gets its own, which is reported so that it can be repeated
+	if(!seed_specified)
+		seed = draw_default_seed();
+	random_engine.seed(seed);
+	device_out << processor_info() << "Random seed: " << seed << endl;
+	session_start_time = chrono::steady_clock::now();
+	round = 0;
+	n_trials_run = 0;
+#ifdef BRUNGART_ALLOCATION_ACCOUNTING
+	// start counting afresh with the first run
+	if(!Allocation_accounting::is_counting())
+		device_out << "Allocation accounting is compiled in, but the plugin's allocations don't reach it; "
+			<< "see Allocation_accounting.h for how to link it" << endl;
+	Allocation_accounting::Counts counts[Allocation_accounting::n_phases_c];
+	Allocation_accounting::take_counts(counts);
+	last_reported_rss_kb = Allocation_accounting::get_current_rss_kb();
+#endif
+	if(stratify_bins)
+		set_stratification_bins();
+	build_runs();
+	if(runs.empty())
+		throw Device_exception(this, string("No cells have trials to run: ") + condition_string);
+	// the estimators must exist before the first trial chooses its SNR
+	if(adaptive_snrs) {
+		// the psychometric function is for both color and digit correct, so a guess is right
+		// one time in the number of colors times the number of digits in the corpus
+		double guess_rate = 1. / (colors.size() * digits.size());
+		estimators.assign(Results_cube::n_speaker_counts_c * n_speaker_conditions_c, 
+			Psychometric_estimator(target_snrs, guess_rate, adaptive_lapse_rate_c));
+		}
+	if(race.is_loaded()) {
+		for(int k = 0; k < race.get_n_candidates(); k++)
+			race.get_candidate(k).results.reset(target_snrs);
+		race_candidate = -1;
+		}
+	run_index = 0;
+	setup_run();
+	if(replay_mode)
+		locate_replay_trial();
+	results.reset(target_snrs);
+	merge_earlier_results();
+	n_runs_completed = 0;
+	// a fork server leaves the trace to its jobs
+	if(!chrome_trace_filename.empty() && fork_jobs_filename.empty()) {
+		if(!chrome_trace.open(chrome_trace_filename))
+			throw Device_exception(this, string("Could not open Chrome trace file ") + chrome_trace_filename);
+		chrome_trace.name_track(simulated_time_pid_c, states_tid_c, "Simulated time", "Device states");
+		chrome_trace.name_track(simulated_time_pid_c, words_tid_c, "Simulated time", "Speech words");
+		chrome_trace.name_track(wall_clock_pid_c, states_tid_c, "Wall clock", "Device states");
+		state_entry_time = get_time();
+		state_entry_wall_us = get_elapsed_seconds() * 1.e6;
+		}
+	// the results are written at the end, so make sure now that they can be;
+	// a fork server writes nothing itself, and neither does a replay
+	if(replay_mode) {
+		set_trace(true);
+		return true;
+		}
+	if(!fork_jobs_filename.empty())
+		return true;
+	// after any fork, since the watchdog's thread would not be in the child
+	if(stall_seconds > 0.)
+		stall_watchdog.start(stall_seconds, stall_exit, "start of the first run");
+	ofstream output_file(output_filename.c_str());
+	if(!output_file)
+		throw Device_exception(this, string("Could not open output file ") + output_filename);
+	if(adaptive_snrs) {
+		string trials_filename = replace_extension(output_filename, "_trials.txt");
+		trials_file.open(trials_filename.c_str());
+		if(!trials_file)
+			throw Device_exception(this, string("Could not open output file ") + trials_filename);
+		trials_file << "n_speakers\tcondition\ttrial\tsnr\tcolor\tdigit\trt" << endl;
+		}
+	if(!descriptors_filename.empty()) {
+		descriptors_file.open(descriptors_filename.c_str());
+		if(!descriptors_file)
+			throw Device_exception(this, string("Could not open descriptors file ") + descriptors_filename);
+		descriptors_file << descriptor_header_c << endl;
+		}
+	if(!cache_filename.empty())
+		use_cached_runs();
+	if(runs.empty()) {
+		write_results();
+		return false;
+		}
+	return true;
+}
+
+// everything outside the run itself that goes into a run's results: the model's .prs file, the corpus,
+// the seed, whether the results are simulated or from the surrogate, the response timeout, and how the model
+// is seeded; stratified sampling is part of the run's identity, and the cursor ply policy doesn't change results
+uint64_t Brungart_device::get_cache_key(const Run_spec& run) const
+{
+	ostringstream oss;
+	oss << hex << run.identity;
+	return Results_cache::hash(oss.str(), config_hash);
+}
+
+// take the results of runs that are in the cache and drop those runs from the session plan
+void Brungart_device::use_cached_runs()
+{
+	if(!cache.open(cache_filename))
+		throw Device_exception(this, string("Could not open results cache ") + cache_filename);
+	ifstream prs_file(get_human_prs_filename().c_str());
+	if(!prs_file)
+		throw Device_exception(this, string("Could not read .prs file for the results cache: ") + get_human_prs_filename());
+	ostringstream prs_contents;
+	prs_contents << prs_file.rdbuf();
+	ostringstream settings;
+	settings << seed << (surrogate_mode ? " surrogate" : " simulate") << " timeout " << response_timeout
+		<< (seed_model_per_trial ? " model_seeding=trial" : "");
+	config_hash = Results_cache::hash(prs_contents.str());
+	config_hash = Results_cache::hash(corpus.get_version_info(), config_hash);
+	config_hash = Results_cache::hash(settings.str(), config_hash);
+	
+	int n_runs = int(runs.size());
+	vector<Run_spec> remaining_runs;
+	vector<double> counts;
+	for(int i = 0; i < runs.size(); i++) {
+		if(!cache.lookup(get_cache_key(runs[i]), counts) 
+			|| counts.size() != Results_cube::n_speaker_counts_c * Results_cube::n_outcomes_c) {
+			remaining_runs.push_back(runs[i]);
+			continue;
+			}
+		for(int ispeakers = 0; ispeakers < Results_cube::n_speaker_counts_c; ispeakers++)
+			for(int io = 0; io < Results_cube::n_outcomes_c; io++)
+				results.add(ispeakers + Results_cube::min_speakers_c, runs[i].condition_index, runs[i].snr_index, io,
+					counts[ispeakers * Results_cube::n_outcomes_c + io]);
+		}
+	runs.swap(remaining_runs);
+	device_out << processor_info() << "Results cache " << cache_filename << ": " << n_runs - runs.size() 
+		<< " of " << n_runs << " runs found" << endl;
+	run_index = 0;
+	if(!runs.empty())
+		setup_run();
+}
+
+// a run's cells are not in any other run, so its results are all the counts in its condition and SNR
+void Brungart_device::store_run_in_cache()
+{
+	const Run_spec& run = runs[run_index];
+	vector<double> counts(Results_cube::n_speaker_counts_c * Results_cube::n_outcomes_c);
+	for(int ispeakers = 0; ispeakers < Results_cube::n_speaker_counts_c; ispeakers++)
+		for(int io = 0; io < Results_cube::n_outcomes_c; io++)
+			counts[ispeakers * Results_cube::n_outcomes_c + io] = 
+				results.get(ispeakers + Results_cube::min_speakers_c, run.condition_index, run.snr_index, io);
+	if(!cache.store(get_cache_key(run), counts))
+		throw Device_exception(this, string("Could not write results cache ") + cache_filename);
+}
+
+bool Brungart_device::setup_next_run()
+{
+	if(cache.is_open())
+		store_run_in_cache();
+	n_runs_completed++;
+	run_index++;
+	if(run_index == runs.size()) {
+		if(race.is_loaded() && plan_next_race_round()) {
+			run_index = 0;
+			setup_run();
+			return false;	// do the next round
+			}
+		write_results();
+		if(deadline_seconds > 0. && plan_next_round()) {
+			run_index = 0;
+			setup_run();
+			return false;	// do the next round
+			}
+		return true;	// time to stop
+		}
+	// during a race round the results are those of whichever candidate is running, so a race checkpoints
+	// only between rounds
+	if(checkpoint_interval && !(n_runs_completed % checkpoint_interval) && !race.is_loaded())
+		write_results();
+	setup_run();
+	return false;	// do the next run
+
+}
+
+// one run for each selected cell that has trials, SNRs within conditions;
+// if blocked, all the runs for each number of speakers in turn, otherwise
+// each run has the trials for every number of speakers in random order;
+// with adaptive SNRs, one run for each condition, with the SNR chosen trial by trial
+void Brungart_device::build_runs()
+{
+	runs.clear();
+	int n_blocks = interleave_speakers ? 1 : int(selected_speakers.size());
+	for(int iblock = 0; iblock < n_blocks; iblock++) {
+		for(int i = 0; i < selected_conditions.size(); i++) {
+			int ic = selected_conditions[i];
+			int n_snr_runs = adaptive_snrs ? 1 : int(target_snrs.size());
+			for(int isnr = 0; isnr < n_snr_runs; isnr++) {
+				Run_spec run(ic, isnr);
+				ostringstream identity;
+				identity << org_masking_condition_labels[ic].substr(0, 2) << ' ' << setprecision(17) << target_snrs[isnr];
+				if(adaptive_snrs)
+					identity << " adaptive";
+				if(interleave_speakers)
+					identity << " interleaved";
+				int first = interleave_speakers ? 0 : iblock;
+				int last = interleave_speakers ? int(selected_speakers.size()) : iblock + 1;
+				for(int k = first; k < last; k++) {
+					int nt = get_cell_n_trials(selected_speakers[k], ic, isnr);
+					if(nt <= 0)
+						continue;
+					run.trial_n_speakers.insert(run.trial_n_speakers.end(), nt, selected_speakers[k]);
+					identity << ' ' << selected_speakers[k] << 'x' << nt;
+					}
+				if(run.trial_n_speakers.empty())
+					continue;
+				// later rounds of a deadline session are different runs of the same cells
+				if(round > 0)
+					identity << " round " << round;
+				if(stratify_bins)
+					identity << " stratified " << stratify_bins;
+				run.identity = Results_cache::hash(identity.str());
+				if(interleave_speakers) {
+					uint32_t run_seed;
+					make_seeds(seed, run.identity, -1, &run_seed, 1);
+					mt19937 run_engine(run_seed);
+					shuffle(run.trial_n_speakers.begin(), run.trial_n_speakers.end(), run_engine);
+					}
+				if(stratify_bins)
+					assign_strata(run);
+				runs.push_back(run);
+				}
+			}
+		}
+	// in a race, every surviving candidate runs the same trials, so that the differences between candidates
+	// aren't blurred by different stimuli
+	if(race.is_loaded()) {
+		vector<Run_spec> cell_runs;
+		cell_runs.swap(runs);
+		for(int k = 0; k < race.get_n_candidates(); k++) {
+			if(!race.get_candidate(k).surviving)
+				continue;
+			for(int i = 0; i < cell_runs.size(); i++) {
+				runs.push_back(cell_runs[i]);
+				runs.back().candidate_index = k;
+				}
+			}
+		}
+}
+
+/* Stratified sampling
+Each trial of a stratified run is given one of the difficulty bins, and its stimulus is drawn the usual way,
+over again until one falls in that bin. For each number of speakers in the run, the bins are used equally often,
+as far as the trials divide, in random order; a trial's outcome is then weighted by the run's trials of that number
+of speakers over the number of bins, divided by the trials given its bin, so each bin counts for the same share of
+the results as it has of the natural mix, and the weighted proportions are stratified estimates. The bin edges are
+placed for each session from a sample drawn with its seed, so their sampling error differs between sessions and
+averages out over replicates. If there are fewer trials than bins, distinct bins are chosen at random, which leaves
+each trial's stimulus with the natural distribution and a weight of one.
+*/
+void Brungart_device::assign_strata(Run_spec& run) const
+{
+	uint32_t strata_seed;
+	make_seeds(seed, run.identity, -2, &strata_seed, 1);
+	mt19937 strata_engine(strata_seed);
+	int n = int(run.trial_n_speakers.size());
+	run.trial_bins.assign(n, 0);
+	run.trial_weights.assign(n, 1.);
+	for(int k = 0; k < selected_speakers.size(); k++) {
+		vector<int> trials;
+		for(int i = 0; i < n; i++)
+			if(run.trial_n_speakers[i] == selected_speakers[k])
+				trials.push_back(i);
+		if(trials.empty())
+			continue;
+		int m = int(trials.size());
+		vector<int> bins;
+		for(int i = 0; i < max(m, stratify_bins); i++)
+			bins.push_back(i % stratify_bins);
+		shuffle(bins.begin(), bins.end(), strata_engine);
+		vector<int> bin_counts(stratify_bins, 0);
+		for(int i = 0; i < m; i++)
+			bin_counts[bins[i]]++;
+		for(int i = 0; i < m; i++) {
+			run.trial_bins[trials[i]] = bins[i];
+			if(m >= stratify_bins)
+				run.trial_weights[trials[i]] = double(m) / stratify_bins / bin_counts[bins[i]];
+			}
+		}
+}
+
+// set the difficulty bin edges for each selected number of speakers and condition from stimuli drawn the usual way
+// with the session's seed
+void Brungart_device::set_stratification_bins()
+{
+	Surrogate_parameters parameters;
+	parameters.load_from_prs_file(get_human_prs_filename());
+	pair_index.load(parameters, corpus);
+	for(int k = 0; k < selected_speakers.size(); k++)
+		for(int i = 0; i < selected_conditions.size(); i++) {
+			int ns = selected_speakers[k];
+			int ic = selected_conditions[i];
+			ostringstream cell;
+			cell << "stratification " << ns << ' ' << ic;
+			uint32_t sample_seed;
+			make_seeds(seed, Results_cache::hash(cell.str()), -1, &sample_seed, 1);
+			mt19937 sample_engine(sample_seed);
+			vector<double> difficulties;
+			Stimulus_draw draw;
+			for(int j = 0; j < stratify_sample_size_c; j++) {
+				draw_stimulus(draw, sample_engine, ns, ic);
+				difficulties.push_back(get_difficulty(draw, ns));
+				}
+			pair_index.set_bins(ns, ic, difficulties, stratify_bins, sample_engine);
+			}
+	device_out << processor_info() << "Stratified sampling in " << stratify_bins << " bins of target-masker difficulty" << endl;
+}
+
+// the number of trials to run in a cell in the current round
+int Brungart_device::get_cell_n_trials(int n_speakers_, int icondition, int isnr) const
+{
+	if(deadline_seconds > 0. && round > 0)
+		return round_allocation[((n_speakers_ - Results_cube::min_speakers_c) * n_speaker_conditions_c + icondition) 
+			* target_snrs.size() + isnr];
+	int nt = default_n_trials;
+	for(int j = 0; j < cell_trials.size(); j++)
+		if(cell_trials[j].condition_index == icondition && cell_trials[j].snr == target_snrs[isnr])
+			nt = cell_trials[j].n_trials;
+	// in a race, the trials that bring the cell up to the round's budget; a cell without race data
+	// can't tell the candidates apart, so it isn't run
+	if(race.is_loaded()) {
+		if(!race.has_observation(n_speakers_, icondition, target_snrs[isnr]))
+			return 0;
+		return get_race_budget(nt, round) - (round ? get_race_budget(nt, round - 1) : 0);
+		}
+	return nt;
+}
+
+// the trials a race has run in a cell by the end of a round
+int Brungart_device::get_race_budget(int n_full_trials, int round_) const
+{
+	long budget = long(race_start_trials) << min(round_, 30);
+	return int(min(long(n_full_trials), budget));
+}
+
+double Brungart_device::get_elapsed_seconds() const
+{
+	return chrono::duration<double>(chrono::steady_clock::now() - session_start_time).count();
+}
+
+/* Deadline rounds
+The first round runs the trials given in the condition string in every cell. At the end of each round, the results
+are written, and the time per trial so far is used to work out how many more trials fit in the time left before
+the deadline, less a planning reserve. Half of them (but at least one per cell) make up the next round, and they
+are shared among the cells run in the first round by Neyman allocation on the proportion of both color and digit
+correct: the total trials in a cell are brought towards proportion to sqrt(p(1-p)), so the cells with the widest
+confidence intervals get the most. Returns false when there is no time for another round.
+*/
+bool Brungart_device::plan_next_round()
+{
+	double elapsed = get_elapsed_seconds();
+	double seconds_per_trial = elapsed / max(n_trials_run, 1L);
+	double available = deadline_seconds * (1. - deadline_planning_reserve_c) - elapsed;
+	if(available <= 0.)
+		return false;
+	long affordable = long(available / seconds_per_trial);
+	
+	// the cells are those with trials so far, all weighted by their estimated standard deviation
+	int n_snrs = int(target_snrs.size());
+	vector<double> weights(Results_cube::n_speaker_counts_c * n_speaker_conditions_c * n_snrs, 0.);
+	vector<double> counts(weights.size(), 0.);
+	int n_cells = 0;
+	double total_weight = 0., total_count = 0.;
+	for(int ns = Results_cube::min_speakers_c; ns < Results_cube::min_speakers_c + Results_cube::n_speaker_counts_c; ns++)
+		for(int ic = 0; ic < n_speaker_conditions_c; ic++)
+			for(int isnr = 0; isnr < n_snrs; isnr++) {
+				double n = results.get_n_trials(ns, ic, isnr);
+				if(!n)
+					continue;
+				int i = ((ns - Results_cube::min_speakers_c) * n_speaker_conditions_c + ic) * n_snrs + isnr;
+				double p = (results.get(ns, ic, isnr, Results_cube::outcome(0, 0)) + 1.) / (n + 2.);
+				weights[i] = sqrt(p * (1. - p));
+				counts[i] = n;
+				total_weight += weights[i];
+				total_count += n;
+				n_cells++;
+				}
+	// not worth another round unless every cell could get a trial
+	if(!n_cells || affordable < n_cells)
+		return false;
+	long budget = max(affordable / 2, long(n_cells));
+	
+	// how far each cell is below its share of the new total, scaled to the budget
+	vector<double> shortfalls(weights.size(), 0.);
+	double total_shortfall = 0.;
+	for(int i = 0; i < weights.size(); i++) {
+		if(!counts[i])
+			continue;
+		shortfalls[i] = max(0., (total_count + budget) * weights[i] / total_weight - counts[i]);
+		total_shortfall += shortfalls[i];
+		}
+	round_allocation.assign(weights.size(), 0);
+	vector<pair<double, int> > remainders;
+	long allocated = 0;
+	for(int i = 0; i < weights.size(); i++) {
+		if(!counts[i])
+			continue;
+		double share = (total_shortfall > 0.) ? budget * shortfalls[i] / total_shortfall : double(budget) / n_cells;
+		round_allocation[i] = int(share);
+		allocated += round_allocation[i];
+		remainders.push_back(make_pair(share - round_allocation[i], i));
+		}
+	// the trials left over by rounding down go to the cells with the largest fractions
+	sort(remainders.rbegin(), remainders.rend());
+	for(int j = 0; allocated < budget && j < remainders.size(); j++, allocated++)
+		round_allocation[remainders[j].second]++;
+	
+	round++;
+	build_runs();
+	if(runs.empty())
+		return false;
+	device_out << processor_info() << "Deadline round " << round << ": " << budget << " trials in " << runs.size() << " runs, " 
+		<< seconds_per_trial << " s per trial, " << deadline_seconds - elapsed << " s left" << endl;
+	return true;
+}
+
+/* Race rounds
+At the end of each round, the survivors' statistics are updated from their results, the clearly worse half is
+dropped, and the standings are written, along with the leader's results if checkpointing. The next round brings every cell up to twice the budget of the last,
+up to the trials given in the condition string, for the survivors only; when there are no more trials to run,
+the race is over, and the leader's results become the session's results. Returns false when the race is over.
+*/
+bool Brungart_device::plan_next_race_round()
+{
+	select_race_candidate(-1);
+	int n_dropped = race.eliminate();
+	write_race_standings();
+	const Parameter_race::Candidate& leader = race.get_candidate(race.get_leader());
+	device_out << processor_info() << "Race round " << round << ": " << n_dropped << " dropped, " << race.get_n_surviving() 
+		<< " left; leader " << leader.name << " statistic " << leader.statistic << " se " << leader.se << endl;
+	round++;
+	build_runs();
+	if(!runs.empty()) {
+		// the checkpoint is the leader's results so far
+		if(checkpoint_interval) {
+			swap(results, race.get_candidate(race.get_leader()).results);
+			write_results();
+			swap(results, race.get_candidate(race.get_leader()).results);
+			}
+		return true;
+		}
+	swap(results, race.get_candidate(race.get_leader()).results);
+	device_out << processor_info() << "Race won by " << leader.name << endl;
+	return false;
+}
+
+// put the current candidate's results back, then take candidate icandidate's and set its parameters;
+// -1 takes none
+void Brungart_device::select_race_candidate(int icandidate)
+{
+	if(race_candidate >= 0)
+		swap(results, race.get_candidate(race_candidate).results);
+	race_candidate = icandidate;
+	if(icandidate < 0)
+		return;
+	Parameter_race::Candidate& candidate = race.get_candidate(icandidate);
+	swap(results, candidate.results);
+	for(int i = 0; i < candidate.parameters.size(); i++)
+		set_human_parameter(candidate.parameters[i].processor, candidate.parameters[i].name, candidate.parameters[i].spec);
+	device_out << processor_info() << "Race candidate " << candidate.name << endl;
+}
+
+// the standings go beside the text output, replaced after every round
+void Brungart_device::write_race_standings()
+{
+	string standings_filename = replace_extension(output_filename, "_race.txt");
+	ofstream standings_file(standings_filename.c_str());
+	if(!standings_file)
+		throw Device_exception(this, string("Could not open race standings file ") + standings_filename);
+	standings_file << race_filename << endl;
+	race.write_standings(standings_file);
+	if(!standings_file)
+		throw Device_exception(this, string("Could not write race standings file ") + standings_filename);
+}
+
+void Brungart_device::setup_run()
+{
+	const Run_spec& run = runs[run_index];
+	if(race.is_loaded() && run.candidate_index != race_candidate)
+		select_race_candidate(run.candidate_index);
+	condition_index = run.condition_index;
+	snr_index = run.snr_index;
+	n_trials = int(run.trial_n_speakers.size());
 	target_loudness = target_snrs[snr_index] + masker_loudness;
 	loudnesses[0] = target_loudness;
+	reset_for_run();
+	setup_trial();
+}
+
+// set the number of speakers, and the SNR if adaptive, for the next trial in the current run
+void Brungart_device::setup_trial()
+{
+	seed_trial();
+	// make trial start time fluctuate
+	trial_start_delay = 450 + device_random_int(100);
+	n_speakers = runs[run_index].trial_n_speakers[trial];
 	// set masking condition lables to reflect number of speakers
 	for(int i = 0; i < n_speaker_conditions_c; i++)
 		masking_condition_labels[i] = org_masking_condition_labels[i].substr(0, n_speakers);
-	reset_for_run();
-	output_file.open("Brungart_device_output.txt");
-    output_file << corpus_version_info << endl;
-    output_file << get_human_prs_filename() << endl;
+	if(adaptive_snrs) {
+		snr_index = get_estimator(n_speakers, condition_index).choose_stimulus();
+		target_loudness = target_snrs[snr_index] + masker_loudness;
+		loudnesses[0] = target_loudness;
+		}
 }
 
-bool Brungart_device::setup_next_run()
+Psychometric_estimator& Brungart_device::get_estimator(int n_speakers_, int icondition)
+{
+	int i = (n_speakers_ - Results_cube::min_speakers_c) * n_speaker_conditions_c + icondition;
+	Assert(i >= 0 && i < estimators.size());
+	return estimators[i];
+}
+
+// a trial's seeds come from the session seed, its run, and its place in the run,
+// so they don't depend on how many random numbers the earlier trials used
+void Brungart_device::seed_trial()
+{
+	uint32_t seeds[2];
+	make_seeds(seed, runs[run_index].identity, trial, seeds, 2);
+	trial_seed = seeds[0];
+	model_seed = seeds[1];
+	random_engine.seed(trial_seed);
+}
+
+// the index of trial itrial of the current run among all the trials in the session with the same condition and SNR
+int Brungart_device::get_cell_trial_index(int itrial) const
+{
+	int k = itrial;
+	for(int i = 0; i < run_index; i++)
+		if(runs[i].condition_index == condition_index && runs[i].snr_index == runs[run_index].snr_index)
+			k += int(runs[i].trial_n_speakers.size());
+	return k;
+}
+
+// set up the run and trial that is trial replay_k of the replay condition and SNR
+void Brungart_device::locate_replay_trial()
 {
-	snr_index++;
-	if(snr_index == target_snrs.size()) {
-		snr_index = 0;
-		condition_index++;
-		if(condition_index == n_speaker_conditions_c) {
-			output_file.close();
-			return true;	// time to stop
+	int k = replay_k;
+	for(run_index = 0; run_index < runs.size(); run_index++) {
+		const Run_spec& run = runs[run_index];
+		if(run.condition_index != replay_condition || target_snrs[run.snr_index] != replay_snr)
+			continue;
+		if(k < run.trial_n_speakers.size()) {
+			setup_run();
+			trial = k;
+			setup_trial();
+			device_out << processor_info() << "Replaying run " << run_index << " trial " << trial 
+				<< " masker speaker: " << masking_condition_labels[condition_index] << " target SNR: " << replay_snr << endl;
+			return;
 			}
-		output_file << endl;	// a blank line
+		k -= int(run.trial_n_speakers.size());
 		}
-	target_loudness = target_snrs[snr_index] + masker_loudness;
-	loudnesses[0] = target_loudness;
-	reset_for_run();
-	return false;	// do the next run
+	throw Device_exception(this, string("replay specifies a trial beyond those run in its cell: ") + condition_string);
+}
 
+// the different numbers of speakers in the current run, in ascending order
+vector<int> Brungart_device::get_run_n_speakers() const
+{
+	vector<int> counts(runs[run_index].trial_n_speakers);
+	sort(counts.begin(), counts.end());
+	counts.erase(unique(counts.begin(), counts.end()), counts.end());
+	return counts;
 }
 
 
-void Brungart_device::handle_Delay_event(const Symbol&, const Symbol&, 
+void Brungart_device::handle_Delay_event(const Symbol& type, const Symbol& datum, 
 		const Symbol&, const Symbol&, const Symbol&)
 {	
+	ACCOUNT_ALLOCATIONS_TO_STATE;
+	if(stop_if_stalled())
+		return;
+	// the response timeout runs alongside the other delays
+	if(type == Response_timeout_c) {
+		handle_response_timeout(datum);
+		return;
+		}
 	switch(state) {
 		case START:
+			// can't do this during construction, because connection to human for parameter setting not yet made
+			if(!setup_first_run()) {
+				stop_session();
+				break;
+				}
+			if(surrogate_mode) {
+				run_surrogate();
+				stop_session();
+				break;
+				}
 			present_number_of_speakers();
-			setup_first_run();		// can't do this during construction, because connection to human for parameter setting not yet made
-			state = PRESENT_CURSOR;
-			schedule_delay_event(300);
+			set_state(PRESENT_CURSOR);
+			schedule_delay_event(n_speakers_display_time_c);
 			break;
 		case PRESENT_CURSOR:
 			remove_number_of_speakers();
 			present_cursor();
-			state = START_TRIAL;
+			set_state(START_TRIAL);
 			schedule_delay_event(200);
 			break;
 		case START_TRIAL:
+			// everything is initialized just before the first trial, so this is where a fork server forks
+			if(!fork_jobs_filename.empty()) {
+				start_fork_server();
+				set_state(FORK_SERVER);
+				schedule_delay_event(0);
+				break;
+				}
+			// show the number of speakers again whenever it changes, before the trial starts
+			if(n_speakers != displayed_n_speakers) {
+				present_number_of_speakers();
+				set_state(CHANGE_N_SPEAKERS);
+				schedule_delay_event(n_speakers_display_time_c);
+				break;
+				}
+			// the architecture's engine is shared with the rest of the process, so it is reseeded from the trial's
+			// seed only when asked for, or when replaying a trial
+			if(seed_model_per_trial || replay_mode)
+				get_Random_engine().seed(model_seed);
+			start_trial_trace();
 			signal_trial_start();
-			// make trial start time fluctuate
-			schedule_delay_event(450 + random_int(100));
-			state = PRESENT_STIMULUS;
+			schedule_delay_event(trial_start_delay);
+			set_state(PRESENT_STIMULUS);
+			break;
+		case FORK_SERVER:
+			if(serve_fork_jobs())
+				stop_session();
 			break;
 		case PRESENT_STIMULUS: 
 			present_stimulus();
@@ -404,10 +1228,22 @@ void Brungart_device::handle_Delay_event(const Symbol&, const Symbol&,
 			break;
 		case ENABLE_RESPONSE: 
 			present_response_objects();
-			state = WAITING_FOR_RESPONSE;
+			set_state(WAITING_FOR_RESPONSE);
+			// without a timeout the device waits for the response as long as it takes; a timeout is counted 
+			// from the last word, and each trial's has its own token, so one that comes due after its trial 
+			// was answered is recognized and ignored
+			response_token++;
+			response_timed_out = false;
+			if(response_timeout)
+				schedule_delay_event(response_timeout - response_enable_delay_time_c, Response_timeout_c, Symbol(response_token));
+			break;
+		case CHANGE_N_SPEAKERS:
+			remove_number_of_speakers();
+			set_state(START_TRIAL);
+			schedule_delay_event(200);
 			break;
 		case SHUTDOWN:
-			stop_simulation();
+			stop_session();
 			break;
 		case WAITING_FOR_RESPONSE:
 		default:
@@ -422,6 +1258,7 @@ void Brungart_device::present_number_of_speakers()
 	set_visual_object_property(Speaker_n_field_c, Color_c, White_c);
 	set_visual_object_property(Speaker_n_field_c, Shape_c, Rectangle_c);
 	set_visual_object_property(Speaker_n_field_c, Text_c, Symbol(n_speakers));
+	displayed_n_speakers = n_speakers;
 }
 
 void Brungart_device::remove_number_of_speakers()
@@ -456,74 +1293,71 @@ void Brungart_device::signal_trial_start()
 */
 }
 
-// colors and digits need to be non-repeated across the 2-4 messages
-// first [0] message is the target, rest are maskers
-// create all four, even if only two will be used
-// speaker genders and id
-void Brungart_device::create_messages()
+// draw the callsigns, colors, digits, and speakers for a trial; the engine is used in the same order as it always
+// has been, so an unstratified session has the same stimuli
+void Brungart_device::draw_stimulus(Stimulus_draw& draw, mt19937& engine, int n_speakers_, int icondition) const
 {
 	// generate randomization of masker callsigns, target and masker colors, target and masker digits
-	// target callsign is fixed at [7], so randomize 0-6 for maskers
-	int callsign_indices[8] = {7, 0, 1, 2, 3, 4, 5, 6};
-//	random_shuffle(callsign_indices+1, callsign_indices+8);
-	shuffle(callsign_indices+1, callsign_indices+8, get_Random_engine());
-	int color_indices[4] = {0, 1, 2, 3};
-//	random_shuffle(color_indices, color_indices+4);
-	shuffle(color_indices, color_indices+4, get_Random_engine());
-	int digit_indices[8] = {0, 1, 2, 3, 4, 5, 6, 7};
-//	random_shuffle(digit_indices, digit_indices+8);
-	shuffle(digit_indices, digit_indices+8, get_Random_engine());
-	
-	Assert(target_callsign == callsigns[callsign_indices[0]]);
-	target_color = colors[color_indices[0]];
-	target_digit = digits[digit_indices[0]];
+	// target callsign is fixed at [7], so randomize the others for maskers
+	draw.callsign_indices.assign(1, target_callsign_index_c);
+	for(int i = 0; i < corpus.get_n_callsigns(); i++)
+		if(i != target_callsign_index_c)
+			draw.callsign_indices.push_back(i);
+	shuffle(draw.callsign_indices.begin()+1, draw.callsign_indices.end(), engine);
+	draw.color_indices.clear();
+	for(int i = 0; i < corpus.get_n_colors(); i++)
+		draw.color_indices.push_back(i);
+	shuffle(draw.color_indices.begin(), draw.color_indices.end(), engine);
+	draw.digit_indices.clear();
+	for(int i = 0; i < corpus.get_n_digits(); i++)
+		draw.digit_indices.push_back(i);
+	shuffle(draw.digit_indices.begin(), draw.digit_indices.end(), engine);
 	
-	vector<int> message_speakers; // first is always target, always 3 maskers following
+	draw.message_speakers.clear(); // first is always target, always 3 maskers following
 	
-	for(int i = 0; i < n_speakers; i++) {
+	for(int i = 0; i < n_speakers_; i++) {
 		// choose gender, speaker of target, then choose maskers depending on condition
-		// these arrays contain the indicies into the speakers array
-		int male_speakers[4] = {0, 1, 2, 3};
-		int female_speakers[4] = {4, 5, 6, 7};
-//		random_shuffle(male_speakers, male_speakers+4);
-		shuffle(male_speakers, male_speakers+4, get_Random_engine());
-//		random_shuffle(female_speakers, female_speakers+4);
-		shuffle(female_speakers, female_speakers+4, get_Random_engine());
-		int target_gender = random_int(2);  // 0 for male, 1 for female
-	
-		switch (condition_index) {
+		// these arrays contain the indicies into the speakers array; the first half are male
+		vector<int> male_speakers, female_speakers;
+		for(int it = 0; it < corpus.get_n_talkers(); it++)
+			(it < corpus.get_n_talkers() / 2 ? male_speakers : female_speakers).push_back(it);
+		shuffle(male_speakers.begin(), male_speakers.end(), engine);
+		shuffle(female_speakers.begin(), female_speakers.end(), engine);
+		int target_gender = uniform_int_distribution<int>(0, 1)(engine);  // 0 for male, 1 for female
+	
+		switch (icondition) {
 			case 0: { //TD different genders and speakers
 				if(target_gender == 0) {// male
-					message_speakers.push_back(male_speakers[0]); // first in random shuffled
-					copy(female_speakers, female_speakers+3, back_inserter(message_speakers)); // first three in shuffled
+					draw.message_speakers.push_back(male_speakers[0]); // first in random shuffled
+					copy(female_speakers.begin(), female_speakers.begin()+3, back_inserter(draw.message_speakers)); // first three in shuffled
 					}
 				else {// female
-					message_speakers.push_back(female_speakers[0]);
-					copy(male_speakers, male_speakers+3, back_inserter(message_speakers));
+					draw.message_speakers.push_back(female_speakers[0]);
+					copy(male_speakers.begin(), male_speakers.begin()+3, back_inserter(draw.message_speakers));
 					}
 				break;
 				}
 			case 1: { //TS - same gender but different talkers
 				if(target_gender == 0) { // male
-					message_speakers.push_back(male_speakers[0]); // first in random shuffled
-					copy(male_speakers+1, male_speakers+4, back_inserter(message_speakers)); // remaining three in shuffled
+					draw.message_speakers.push_back(male_speakers[0]); // first in random shuffled
+					copy(male_speakers.begin()+1, male_speakers.begin()+4, back_inserter(draw.message_speakers)); // remaining three in shuffled
 					}
 				else {// female
-					message_speakers.push_back(female_speakers[0]);
-					copy(female_speakers+1, female_speakers+4, back_inserter(message_speakers));
+					draw.message_speakers.push_back(female_speakers[0]);
+					copy(female_speakers.begin()+1, female_speakers.begin()+4, back_inserter(draw.message_speakers));
 					}
 				break;
 				}
 			case 2: { //TT - same talker of that gender
 				if(target_gender == 0) { // male
-					message_speakers.push_back(male_speakers[0]); // first in random shuffled
+					draw.message_speakers.push_back(male_speakers[0]); // first in random shuffled
 					for(int i = 1; i != 4; i++)
-						message_speakers.push_back(male_speakers[0]);	// 3 more copies of target speaker index
+						draw.message_speakers.push_back(male_speakers[0]);	// 3 more copies of target speaker index
 					}
 				else {// female
-					message_speakers.push_back(female_speakers[0]);
+					draw.message_speakers.push_back(female_speakers[0]);
 					for(int i = 1; i != 4; i++)
-						message_speakers.push_back(female_speakers[0]);	// 3 more copies of target speaker index
+						draw.message_speakers.push_back(female_speakers[0]);	// 3 more copies of target speaker index
 					}
 				break;
 				}
@@ -532,6 +1366,42 @@ void Brungart_device::create_messages()
 				break;
 			}
 		}
+}
+
+// the difficulty of a drawn stimulus for stratified sampling
+double Brungart_device::get_difficulty(const Stimulus_draw& draw, int n_speakers_) const
+{
+	return pair_index.get_difficulty(draw.message_speakers.data(), draw.callsign_indices.data(), draw.color_indices.data(), 
+		draw.digit_indices.data(), n_speakers_);
+}
+
+// colors and digits need to be non-repeated across the 2-4 messages
+// first [0] message is the target, rest are maskers
+// create all four, even if only two will be used
+// speaker genders and id
+void Brungart_device::create_messages()
+{
+	Stimulus_draw draw;
+	draw_stimulus(draw, random_engine, n_speakers, condition_index);
+	// if stratified, draw again until the stimulus falls in the trial's bin; each bin holds about an equal share
+	// of the stimuli, so this takes about as many draws as there are bins
+	if(stratify_bins) {
+		int bin = runs[run_index].trial_bins[trial];
+		int n_draws = 1;
+		while(pair_index.get_bin(n_speakers, condition_index, get_difficulty(draw, n_speakers), random_engine) != bin) {
+			if(++n_draws > max_stratum_draws_c)
+				throw Device_exception(this, "Could not draw a stimulus in the trial's difficulty bin");
+			draw_stimulus(draw, random_engine, n_speakers, condition_index);
+			}
+		}
+	const vector<int>& callsign_indices = draw.callsign_indices;
+	const vector<int>& color_indices = draw.color_indices;
+	const vector<int>& digit_indices = draw.digit_indices;
+	const vector<int>& message_speakers = draw.message_speakers;
+	
+	Assert(target_callsign == callsigns[callsign_indices[0]]);
+	target_color = colors[color_indices[0]];
+	target_digit = digits[digit_indices[0]];
 	
 	// create the messages, target message should be first one
 	for(int i = 0; i < n_speakers; i++) {
@@ -540,7 +1410,8 @@ void Brungart_device::create_messages()
 //			<< color_indices[i] << ' ' << digit_indices[i] << endl;
         messages[i] = Message(this, stream_names[i], speakers[is].gender, speakers[is].id,
                             is, callsign_indices[i], color_indices[i], digit_indices[i],
-							utterance_data[is][callsign_indices[i]][color_indices[i]][digit_indices[i]],
+							corpus.get_utterance_id(is, callsign_indices[i], color_indices[i], digit_indices[i]),
+							corpus.get(is, callsign_indices[i], color_indices[i], digit_indices[i]),
 							loudnesses[i], // baseline loudness - -12 to + 12 for target, 0 for maskers
 							// kludge for Greg's 1/2/12 Markov model
 	//						loudnesses[i], .1,	// each word sampled using this mean and sd for loudness
@@ -597,7 +1468,7 @@ void Brungart_device::present_stimulus()
 	// note the time, then start the two messages
 	stimulus_onset_time = get_time();
 	word_counter = 0;
-	state = NEXT_WORD;
+	set_state(NEXT_WORD);
 	present_next_word();
 }
 
@@ -607,7 +1478,7 @@ void Brungart_device::present_next_word()
 	// did we say the last word?
 	if(word_counter == message_length_c) {
 		// enable the response after a delay
-		state = ENABLE_RESPONSE;
+		set_state(ENABLE_RESPONSE);
 		schedule_delay_event(response_enable_delay_time_c);
 		return;
 		}
@@ -622,6 +1493,15 @@ void Brungart_device::present_next_word()
 		// have each message generate its next word
 		messages[i].present_word(trial, word_counter);
 		}
+	// the word slot is named by the target's word, with every stream's word as an argument
+	if(chrome_trace.is_open()) {
+		ostringstream name, args;
+		name << messages[0].message[word_counter];
+		args << "\"trial\":" << trial;
+		for(int i = 0; i < n_speakers; i++)
+			args << ",\"" << messages[i].stream_name << "\":\"" << messages[i].message[word_counter] << "\"";
+		chrome_trace.add_span(simulated_time_pid_c, words_tid_c, name.str(), "word", get_time() * 1000., duration * 1000., args.str());
+		}
 	// if this is the first word, supply the location corresponding to the source
 	schedule_delay_event(duration + 10);  // put a bit of space after each word
 	word_counter++;
@@ -667,28 +1547,61 @@ void Brungart_device::remove_response_objects()
 void Brungart_device::handle_Ply_event(const Symbol& cursor_name, const Symbol& target_name,
 		GU::Point new_location, GU::Polar_vector)
 {
-	if(state != WAITING_FOR_RESPONSE)
+	ACCOUNT_ALLOCATIONS_TO_STATE;
+	if(stop_if_stalled())
+		return;
+	if(state != WAITING_FOR_RESPONSE) {
+		if(response_timed_out)
+			return;	// too late; the trial has already been scored
 		throw Device_exception(this, "Ply received while not waiting for a response");
+		}
 	
 	// update the cursor position
 	// sanity check
 	Assert(Cursor_name_c == cursor_name);
 	cursor_location = new_location;
-	set_visual_object_location(Cursor_name_c, cursor_location);
 	current_pointed_to_object = target_name;
-	if(get_trace() && Trace_out && current_pointed_to_object != "nil")
-		Trace_out << processor_info() << "Ply to: " << current_pointed_to_object << endl;
-	else if(get_trace() && Trace_out) // shows intermediate points
-		Trace_out << processor_info() << "Ply to: " << current_pointed_to_object << endl;
+	cursor_update_pending = true;
+	n_plies++;
+	// shows intermediate points as well as the final one unless they are coalesced
+	if(ply_policy == Condition_options::PLY_EACH || (ply_policy == Condition_options::PLY_INTERVAL && get_time() - last_cursor_update_time >= ply_interval))
+		show_cursor_location();
+}
+
+// move the visual cursor to where the plies have taken it, if it isn't there already
+void Brungart_device::show_cursor_location()
+{
+	if(!cursor_update_pending)
+		return;
+	set_visual_object_location(Cursor_name_c, cursor_location);
+	cursor_update_pending = false;
+	last_cursor_update_time = get_time();
+	n_cursor_updates++;
+	if(trace_trial) {
+		ostringstream oss;
+		oss << processor_info() << "Ply to: " << current_pointed_to_object << endl;
+		emit_trace(oss.str());
+		}
 }
 
 // here if a keystroke event is received
 void Brungart_device::handle_Keystroke_event(const Symbol& key_name)
 {
-	if(state != WAITING_FOR_RESPONSE)
+	ACCOUNT_ALLOCATIONS_TO_STATE;
+	if(stop_if_stalled())
+		return;
+	if(state != WAITING_FOR_RESPONSE) {
+		if(response_timed_out)
+			return;	// too late; the trial has already been scored
 		throw Device_exception(this, "Keystroke received while not waiting for a response");
-	if(get_trace() && Trace_out)
-		Trace_out << processor_info() << "Keystroke: " << key_name << endl;
+		}
+	// a coalesced final ply is shown before the response, where it would have been
+	show_cursor_location();
+	if(trace_trial) {
+		ostringstream oss;
+		oss << processor_info() << "Keystroke: " << key_name << endl;
+		emit_trace(oss.str());
+		}
 	
 	rt = get_time() - stimulus_onset_time;
 		
@@ -698,21 +1611,180 @@ void Brungart_device::handle_Keystroke_event(const Symbol& key_name)
 	
 	// score the response
 	score_response();
+	finish_trial();
+}
+
+// here if the response timeout scheduled when the response was enabled comes due; 
+// it is stale if the response came first
+void Brungart_device::handle_response_timeout(const Symbol& token)
+{
+	if(state != WAITING_FOR_RESPONSE || token != Symbol(response_token))
+		return;
+	response_timed_out = true;
+	rt = get_time() - stimulus_onset_time;
+	show_cursor_location();
+	remove_response_objects();
+	trial++;
+	score_timeout();
+	finish_trial();
+}
+
+// a stall found by the watchdog stops the session at the device's next event, on the simulation's own thread,
+// with the results so far written; a run cut short is in the output files but not the cache
+bool Brungart_device::stop_if_stalled()
+{
+	if(!stall_watchdog.has_stalled())
+		return false;
+	if(stall_watchdog.is_running()) {
+		stall_watchdog.stop();
+		device_out << processor_info() << "Stopping the stalled session and writing the results so far" << endl;
+		write_results();
+		// a forked job that stalled is reported to the fork server as failed
+		if(forked_job)
+			end_forked_job(EXIT_FAILURE);
+		stop_session();
+		}
+	return true;
+}
+
+// after a trial is scored, go on to the next trial or run, or stop
+void Brungart_device::finish_trial()
+{
+	if(replay_mode) {
+		stop_session();
+		return;
+		}
+	n_trials_run++;
+	// stop with what has been done if the deadline is close; the output is written as a whole, so it is complete
+	if(deadline_seconds > 0. && get_elapsed_seconds() >= deadline_seconds * (1. - deadline_stop_reserve_c)) {
+		device_out << processor_info() << "Deadline reached after " << n_trials_run << " trials" << endl;
+		write_results();
+		stop_session();
+		return;
+		}
+	// the intertrial interval is drawn before the next trial reseeds the engine
+	long iti = iti_c + device_random_int(100);
 	
 //	output_statistics();
 	if(!(trial % 100))
 		device_out << processor_info() << "Trial " << trial << endl;
 
 	if(trial >= n_trials) {
-		output_statistics();
+		vector<int> run_n_speakers = get_run_n_speakers();
+		for(int i = 0; i < run_n_speakers.size(); i++) {
+			if(adaptive_snrs)
+				output_psychometric_fit(run_n_speakers[i]);
+			else
+				output_statistics(run_n_speakers[i]);
+			}
+		output_allocation_report();
+		if(ply_policy != Condition_options::PLY_EACH)
+			device_out << processor_info() << "Cursor updates: " << n_cursor_updates << " shown for " << n_plies << " plies" << endl;
 		if(setup_next_run()) {
-			stop_simulation();
+			stop_session();
 			return;
 			}
 		}
+	else
+		setup_trial();
 		
-	state = START_TRIAL;
-	schedule_delay_event(iti_c + random_int(100));
+	set_state(START_TRIAL);
+	schedule_delay_event(iti);
+}
+
+// change state; with a Chrome trace, the time spent in the state being left becomes a span on
+// both the simulated time and wall clock tracks
+void Brungart_device::set_state(State_e new_state)
+{
+	if(chrome_trace.is_open()) {
+		long now = get_time();
+		double wall_now_us = get_elapsed_seconds() * 1.e6;
+		chrome_trace.add_span(simulated_time_pid_c, states_tid_c, state_names_c[state], "state", 
+			state_entry_time * 1000., (now - state_entry_time) * 1000., state_entry_args);
+		chrome_trace.add_span(wall_clock_pid_c, states_tid_c, state_names_c[state], "state", 
+			state_entry_wall_us, wall_now_us - state_entry_wall_us, state_entry_args);
+		// the span is labeled with the run and trial current when the state is entered
+		ostringstream args;
+		args << "\"run\":" << run_index << ",\"trial\":" << trial;
+		state_entry_time = now;
+		state_entry_wall_us = wall_now_us;
+		state_entry_args = args.str();
+		}
+	state = new_state;
+}
+
+// all device randomization uses the device's own engine, never the shared global one
+int Brungart_device::device_random_int(int range)
+{
+	Assert(range > 0);
+	uniform_int_distribution<int> dist(0, range - 1);
+	return dist(random_engine);
+}
+
+// decide whether this trial is traced; the decision holds until the response is scored. An untraced trial
+// turns off only this device's trace flag, since Trace_out is shared by every device and the architecture
+void Brungart_device::start_trial_trace()
+{
+	trace_trial = false;
+	if(!(get_trace() && Trace_out))
+		return;
+	switch(trace_policy) {
+		case Condition_options::TRACE_ALL:
+		case Condition_options::TRACE_ERRORS:	// can't tell until scored, so hold the trace until then
+			trace_trial = true;
+			break;
+		case Condition_options::TRACE_EVERY_NTH:
+			trace_trial = !(trial % trace_interval);
+			break;
+		case Condition_options::TRACE_CELL:
+			trace_trial = masking_condition_labels[condition_index].substr(0, 2) == trace_condition 
+				&& target_snrs[snr_index] == trace_snr;
+			break;
+		}
+	trial_trace.str("");
+	if(!trace_trial) {
+		suspend_trace();
+		return;
+		}
+	ostringstream oss;
+	oss << processor_info() << "Trial start: " << trial << " masker speaker: " << masking_condition_labels[condition_index]
+		<< " target SNR: " << target_snrs[snr_index] << endl;
+	emit_trace(oss.str());
+}
+
+void Brungart_device::emit_trace(const string& line)
+{
+	if(trace_policy == Condition_options::TRACE_ERRORS)
+		trial_trace << line;
+	else
+		Trace_out << line;
+}
+
+// turn tracing off for the rest of the trial; a held trace is written only if the response was in error
+void Brungart_device::finish_trial_trace(bool response_in_error)
+{
+	resume_trace();
+	if(trace_trial && trace_policy == Condition_options::TRACE_ERRORS && response_in_error)
+		Trace_out << trial_trace.str();
+	trial_trace.str("");
+	trace_trial = false;
+}
+
+// turn off the device's trace flag for an untraced trial, and turn it back on when the trial is scored
+void Brungart_device::suspend_trace()
+{
+	if(trace_suspended)
+		return;
+	set_trace(false);
+	trace_suspended = true;
+}
+
+void Brungart_device::resume_trace()
+{
+	if(!trace_suspended)
+		return;
+	set_trace(true);
+	trace_suspended = false;
 }
 
 void Brungart_device::set_parameter(const string& proc_name, const string& param_name, const string& spec, double value)
@@ -739,25 +1811,6 @@ void Brungart_device::score_response()
 	bool color_correct = (response_color == target_color);
 	bool digit_correct = (response_digit == target_digit);
 	
-	if(color_correct && digit_correct)
-		n_completely_correct++;
-	else if(color_correct && !digit_correct)
-		n_color_only_correct++;
-	else if(!color_correct && digit_correct)
-		n_digit_only_correct++;
-	else if(!color_correct && !digit_correct)
-		n_completely_incorrect++;
-
-	Assert(n_completely_correct+n_color_only_correct+n_digit_only_correct+n_completely_incorrect == trial);
-	
-	if(!(trial % 100))
-			device_out << processor_info()
-			<< " Trial: " << trial << " masker speaker: " << masking_condition_labels[condition_index] << " target SNR: " << target_snrs[snr_index]
-			<<" N. target: both, color, digit, neither: " 
-			<< n_completely_correct << ' ' << n_color_only_correct << ' ' << n_digit_only_correct << ' ' << n_completely_incorrect 
-			<< " rt: " << rt << endl;
-
-
 	// find out if color is a masker color, likewise for digit
 	bool masker_color = false;
 	for(int i = 1; i < n_speakers; i++)
@@ -771,74 +1824,141 @@ void Brungart_device::score_response()
 	
 	Assert(!(digit_correct && masker_digit));
 	
-	if(masker_color && masker_digit)
-		n_masker_both++;
-	else if(masker_color && !masker_digit)
-		n_masker_color_only++;
-	else if(!masker_color && masker_digit)
-		n_masker_digit_only++;
-	else if(!masker_color && !masker_digit)
-		n_masker_neither++;	
-
-	if(!(trial % 100))
-		device_out << " masker: " << n_masker_both << ' ' << n_masker_color_only << ' ' << n_masker_digit_only << ' ' << n_masker_neither << endl;
-
-	if(color_correct)
-		n_target_color++;
-	else if(masker_color)
-		n_masker_color++;
-	else 
-		n_neither_color++;
-
-	if(digit_correct)
-		n_target_digit++;
-	else if(masker_digit)
-		n_masker_digit++;
-	else 
-		n_neither_digit++;
-		
 	// calculate subscripts for contingency table 0 is color/digit correct, 1 is masker, 2 is neither
 	int icr = (color_correct) ? 0 : ((masker_color) ? 1 : 2);
 	int idr = (digit_correct) ? 0 : ((masker_digit) ? 1 : 2);
-	n_color_digit_table[icr][idr]++;
-	
-		
-	if(!(trial % 100))
+	if(trace_trial) {
+		const char labels[3] = {'T', 'M', 'N'};
+		ostringstream oss;
+		oss << processor_info() << "Response: " << response_color << ' ' << response_digit 
+			<< " color/digit scored " << labels[icr] << labels[idr] << " rt: " << rt << endl;
+		emit_trace(oss.str());
+		}
+	record_outcome(icr, idr);
+}
+
+// score a trial with no response before the timeout
+void Brungart_device::score_timeout()
+{
+	if(trace_trial) {
+		ostringstream oss;
+		oss << processor_info() << "Response timed out after " << rt << endl;
+		emit_trace(oss.str());
+		}
+	record_outcome(timeout_category_c, timeout_category_c);
+}
+
+// add the trial's outcome to the results and the per-trial outputs; the categories are 0 for target, 1 for masker,
+// 2 for neither, or both timeout_category_c for a timeout
+void Brungart_device::record_outcome(int icr, int idr)
+{
+	const char labels[4] = {'T', 'M', 'N', 'X'};
+	bool timed_out = (icr == timeout_category_c);
+	// a stratified trial counts for the share of the natural mix its bin stands for
+	const Run_spec& run = runs[run_index];
+	double weight = run.trial_weights.empty() ? 1. : run.trial_weights[trial - 1];
+	results.add(n_speakers, condition_index, snr_index, timed_out ? Results_cube::timeout_outcome_c : Results_cube::outcome(icr, idr), 
+		weight);
+
+	if(!interleave_speakers && !adaptive_snrs && !replay_mode && !round && !stratify_bins && merge_filenames.empty())
+		Assert(results.get_n_trials(n_speakers, condition_index, snr_index) == trial);
+	if(adaptive_snrs) {
+		get_estimator(n_speakers, condition_index).update(snr_index, icr == 0 && idr == 0);
+		trials_file << n_speakers << '\t' << masking_condition_labels[condition_index] << '\t' << trial << '\t' 
+			<< target_snrs[snr_index] << '\t' << labels[icr] << '\t' << labels[idr] << '\t' << rt << endl;
+		}
+
+	if(!(trial % 100)) {
+		double table[3][3];
+		results.get_table(n_speakers, condition_index, snr_index, table);
+		device_out << processor_info()
+			<< " Trial: " << trial << " masker speaker: " << masking_condition_labels[condition_index] << " target SNR: " << target_snrs[snr_index]
+			<<" N. target: both, color, digit, neither: " 
+			<< table[0][0] << ' ' << table[0][1] + table[0][2] << ' ' << table[1][0] + table[2][0] << ' ' 
+			<< table[1][1] + table[1][2] + table[2][1] + table[2][2]
+			<< " rt: " << rt << endl;
+		device_out << " masker: " << table[1][1] << ' ' << table[1][0] + table[1][2] << ' ' << table[0][1] + table[2][1] << ' ' 
+			<< table[0][0] + table[0][2] + table[2][0] + table[2][2] << endl;
 		device_out << " target-masker-neither color/digit: " 
-			<< n_target_color << ' ' << n_masker_color << ' ' << n_neither_color << ' '
-			<< n_target_digit << ' ' << n_masker_digit << ' ' << n_neither_digit << endl;
+			<< table[0][0] + table[0][1] + table[0][2] << ' ' << table[1][0] + table[1][1] + table[1][2] << ' ' 
+			<< table[2][0] + table[2][1] + table[2][2] << ' '
+			<< table[0][0] + table[1][0] + table[2][0] << ' ' << table[0][1] + table[1][1] + table[2][1] << ' ' 
+			<< table[0][2] + table[1][2] + table[2][2] << endl;
+		}
 	
+	if(descriptors_file.is_open())
+		write_trial_descriptor(descriptors_file, icr, idr);
+	if(replay_mode) {
+		ostringstream oss;
+		write_trial_descriptor(oss, icr, idr);
+		device_out << descriptor_header_c << endl << oss.str();
+		}
+	finish_trial_trace(icr != 0 || idr != 0);
+	if(stall_watchdog.is_running()) {
+		ostringstream oss;
+		oss << "run " << run_index << " trial " << trial << " masker speaker: " << masking_condition_labels[condition_index] 
+			<< " target SNR: " << target_snrs[snr_index] << " simulated time " << get_time();
+		stall_watchdog.note_progress(oss.str());
+		}
 }
 
+// one line with everything needed to find and replay the trial just scored: its place in the session plan and
+// in its cell, its seeds, its start delay, and for each message the talker, callsign, color, and digit indices
+void Brungart_device::write_trial_descriptor(ostream& os, int icr, int idr)
+{
+	const char labels[4] = {'T', 'M', 'N', 'X'};
+	int itrial = trial - 1;	// already counted
+	os << run_index << '\t' << itrial << '\t' << n_speakers << '\t' << masking_condition_labels[condition_index] << '\t' 
+		<< target_snrs[snr_index] << '\t' << get_cell_trial_index(itrial) << '\t' << trial_seed << '\t' << model_seed << '\t'
+		<< trial_start_delay << '\t';
+	for(int i = 0; i < n_speakers; i++) {
+		if(i)
+			os << ',';
+		os << messages[i].talker_idx << '/' << messages[i].callsign_idx << '/' << messages[i].color_idx << '/' << messages[i].digit_idx;
+		}
+	os << '\t' << labels[icr] << '\t' << labels[idr] << '\t' << rt << endl;
+}
 
-void Brungart_device::output_statistics()
+void Brungart_device::output_statistics(int n_speakers_)
 {
 	// output the results
-	Assert(n_completely_correct+n_color_only_correct+n_digit_only_correct+n_completely_incorrect == n_trials);
+	double table[3][3];
+	results.get_table(n_speakers_, condition_index, snr_index, table);
+	double n = results.get_n_trials(n_speakers_, condition_index, snr_index);
+	// stratified weights add up to the number of trials, but not always exactly
+	Assert(interleave_speakers || round || stratify_bins || !merge_filenames.empty() || n == n_trials);
+	string masking_condition_label = org_masking_condition_labels[condition_index].substr(0, n_speakers_);
+	double color_counts[3] = {0., 0., 0.};
+	double digit_counts[3] = {0., 0., 0.};
+	for(int icr = 0; icr < 3; icr++)
+		for(int idr = 0; idr < 3; idr++) {
+			color_counts[icr] += table[icr][idr];
+			digit_counts[idr] += table[icr][idr];
+			}
 	
 	device_out 
 //		<< "Trials: " << n_trials << " P(Content masked): " << content_masking_probs[condition_index] << " P(Stream masked): " << stream_masking_probs[snr_index]
 //		<< "Trials: " << n_trials << " masker gender: " << masker_genders[condition_index] << " P(Stream masked): " << stream_masking_probs[snr_index]
-		<< "Trials: " << n_trials << " masker speaker: " << masking_condition_labels[condition_index] << " target SNR: " << target_snrs[snr_index]
+		<< "Trials: " << n << " masker speaker: " << masking_condition_label << " target SNR: " << target_snrs[snr_index]
 		<< "\nTarget proportions correct: both, color-only, digit-only, neither, all color, all digit:\n"
-		<< double(n_completely_correct)/n_trials << ", " << double(n_color_only_correct)/n_trials   << ", " 
-		<< double(n_digit_only_correct)/n_trials  << ", " 
-		<< double(n_completely_incorrect)/n_trials  << ", " 
-		<< double(n_completely_correct + n_color_only_correct)/n_trials  << ", " 
-		<< double(n_completely_correct + n_digit_only_correct)/n_trials 
+		<< table[0][0]/n << ", " << (table[0][1] + table[0][2])/n   << ", " 
+		<< (table[1][0] + table[2][0])/n  << ", " 
+		<< (table[1][1] + table[1][2] + table[2][1] + table[2][2])/n  << ", " 
+		<< color_counts[0]/n  << ", " 
+		<< digit_counts[0]/n 
 		<< endl;
 
 	device_out << "Masker proportions: both, color-only, digit-only, neither, all color, all digit:\n"
-			<< double(n_masker_both)/n_trials << ", " << double(n_masker_color_only)/n_trials   << ", " 
-			<< double(n_masker_digit_only)/n_trials  << ", " 
-			<< double(n_masker_neither)/n_trials  << ", " 
-			<< double(n_masker_both + n_masker_color_only)/n_trials  << ", " 
-			<< double(n_masker_both + n_masker_digit_only)/n_trials 
+			<< table[1][1]/n << ", " << (table[1][0] + table[1][2])/n   << ", " 
+			<< (table[0][1] + table[2][1])/n  << ", " 
+			<< (table[0][0] + table[0][2] + table[2][0] + table[2][2])/n  << ", " 
+			<< color_counts[1]/n  << ", " 
+			<< digit_counts[1]/n 
 			<< endl;
 
 	device_out << "Target/masker/neither proportions: all color, all digit:\n"
-			<< double(n_target_color)/n_trials << "\t" << double(n_masker_color)/n_trials   << "\t" << double(n_neither_color)/n_trials  << "\t" 
-			<< double(n_target_digit)/n_trials  << "\t" << double(n_masker_digit)/n_trials  << "\t" << double(n_neither_digit)/n_trials
+			<< color_counts[0]/n << "\t" << color_counts[1]/n   << "\t" << color_counts[2]/n  << "\t" 
+			<< digit_counts[0]/n  << "\t" << digit_counts[1]/n  << "\t" << digit_counts[2]/n
 			<< endl;
 
 	device_out << "Color (rows) Digit (columns) contingency table: Target, Masker, Neither:" << endl;
@@ -849,22 +1969,354 @@ void Brungart_device::output_statistics()
 	for(int icr = 0; icr < 3; icr++) {
 		device_out << label[icr] << "\t";
 		for(int idr = 0; idr < 3; idr++) {
-			device_out << n_color_digit_table[icr][idr] << "\t";
+			device_out << table[icr][idr] << "\t";
 			}
 		device_out << endl;
 		}
+	double n_timeouts = results.get_n_timeouts(n_speakers_, condition_index, snr_index);
+	if(n_timeouts)
+		device_out << "Response timeouts: " << n_timeouts << endl;
+}
+
+// with allocation accounting compiled in, the device's allocations per trial in each state over the run just completed,
+// and those the device's code made between its events; the architecture's own allocations aren't counted, so a
+// net count (allocations less frees) that stays positive run after run points to a leak in the device, and resident
+// memory that keeps growing without one points elsewhere in the process
+void Brungart_device::output_allocation_report()
+{
+#ifdef BRUNGART_ALLOCATION_ACCOUNTING
+	const int n_states = sizeof(state_names_c) / sizeof(state_names_c[0]);
+	Assert(n_states < Allocation_accounting::outside_phase_c);
+	Allocation_accounting::Counts counts[Allocation_accounting::n_phases_c];
+	Allocation_accounting::take_counts(counts);
+	double n = max(n_trials, 1);
+	device_out << "Device allocations per trial over " << n_trials << " trials: allocations, bytes, net allocations:" << endl;
+	for(int i = 0; i < Allocation_accounting::n_phases_c; i++) {
+		if(!counts[i].n_allocations && !counts[i].n_frees)
+			continue;
+		const char * name = (i < n_states) ? state_names_c[i] : "between events";
+		device_out << "\t" << name << "\t" << counts[i].n_allocations / n << "\t" << counts[i].n_bytes / n 
+			<< "\t" << (counts[i].n_allocations - counts[i].n_frees) / n << endl;
+		}
+	long rss_kb = Allocation_accounting::get_current_rss_kb();
+	device_out << "Process resident memory (KB): current " << rss_kb << " change " << rss_kb - last_reported_rss_kb 
+		<< " peak " << Allocation_accounting::get_peak_rss_kb() << endl;
+	last_reported_rss_kb = rss_kb;
+#endif
+}
+
+// add the counts in the binary output of earlier sessions with the same SNRs, such as replicates run with other
+// seeds or shards of the cells, so that this session's output pools them with its own
+void Brungart_device::merge_earlier_results()
+{
+	for(int i = 0; i < merge_filenames.size(); i++) {
+		ifstream merge_file(merge_filenames[i].c_str(), ios::binary);
+		Results_cube earlier;
+		if(!merge_file || !earlier.read_binary(merge_file))
+			throw Device_exception(this, string("Could not read binary results to merge from ") + merge_filenames[i]);
+		if(!results.accumulate(earlier))
+			throw Device_exception(this, string("Binary results to merge have different SNRs: ") + merge_filenames[i]);
+		}
+	if(!merge_filenames.empty())
+		device_out << processor_info() << "Merged the results of " << merge_filenames.size() << " earlier sessions" << endl;
+}
+
+// write every cell that has trials, in the tab-separated layout and in binary form;
+// each file is written under a temporary name and then renamed, so that a checkpoint 
+// never leaves a partly written file in place of the previous one
+void Brungart_device::write_results()
+{
+	string temp_filename = output_filename + ".tmp";
+	ofstream output_file(temp_filename.c_str());
+	if(!output_file)
+		throw Device_exception(this, string("Could not open output file ") + temp_filename);
+    output_file << corpus.get_version_info() << endl;
+    output_file << get_human_prs_filename() << endl;
+	// rows are tagged with the number of speakers only if there is more than one
+	bool tag_n_speakers = selected_speakers.size() > 1;
+	bool rows_written = false;
+	for(int ns = Results_cube::min_speakers_c; ns < Results_cube::min_speakers_c + Results_cube::n_speaker_counts_c; ns++) {
+		for(int ic = 0; ic < Results_cube::n_conditions_c; ic++) {
+			bool block_started = false;
+			for(int isnr = 0; isnr < results.get_n_snrs(); isnr++) {
+				if(!results.get_n_trials(ns, ic, isnr))
+					continue;
+				if(rows_written && !block_started)
+					output_file << endl;	// a blank line between masking conditions
+				block_started = true;
+				rows_written = true;
+				write_output_row(output_file, ns, ic, isnr, tag_n_speakers);
+				}
+			}
+		}
+	output_file.close();
+	if(!output_file || rename(temp_filename.c_str(), output_filename.c_str()))
+		throw Device_exception(this, string("Could not write output file ") + output_filename);
+	
+	temp_filename = binary_output_filename + ".tmp";
+	ofstream binary_file(temp_filename.c_str(), ios::binary);
+	if(!binary_file)
+		throw Device_exception(this, string("Could not open output file ") + temp_filename);
+	results.write_binary(binary_file);
+	binary_file.close();
+	if(!binary_file || rename(temp_filename.c_str(), binary_output_filename.c_str()))
+		throw Device_exception(this, string("Could not write output file ") + binary_output_filename);
+	
+	if(!adaptive_snrs)
+		return;
+	string fits_filename = replace_extension(output_filename, "_fits.txt");
+	temp_filename = fits_filename + ".tmp";
+	ofstream fits_file(temp_filename.c_str());
+	if(!fits_file)
+		throw Device_exception(this, string("Could not open output file ") + temp_filename);
+	write_psychometric_fits(fits_file);
+	fits_file.close();
+	if(!fits_file || rename(temp_filename.c_str(), fits_filename.c_str()))
+		throw Device_exception(this, string("Could not write output file ") + fits_filename);
+}
 
+void Brungart_device::output_psychometric_fit(int n_speakers_)
+{
+	const Psychometric_estimator& estimator = get_estimator(n_speakers_, condition_index);
+	device_out << "Trials: " << estimator.get_n_trials() << " masker speaker: " 
+		<< org_masking_condition_labels[condition_index].substr(0, n_speakers_)
+		<< " threshold: " << estimator.get_threshold_mean() << " (sd " << estimator.get_threshold_sd() << ")"
+		<< " slope: " << estimator.get_slope_mean() << " (sd " << estimator.get_slope_sd() << ")" << endl;
+}
+
+// the posterior threshold and slope, with their standard deviations, for each speakers and condition with trials
+void Brungart_device::write_psychometric_fits(ostream& os)
+{
+	os << "n_speakers\tcondition\tn_trials\tthreshold\tthreshold_sd\tslope\tslope_sd" << endl;
+	for(int ns = Results_cube::min_speakers_c; ns < Results_cube::min_speakers_c + Results_cube::n_speaker_counts_c; ns++) {
+		for(int ic = 0; ic < n_speaker_conditions_c; ic++) {
+			const Psychometric_estimator& estimator = get_estimator(ns, ic);
+			if(!estimator.get_n_trials())
+				continue;
+			os << ns << "\t" << org_masking_condition_labels[ic].substr(0, ns) << "\t" << estimator.get_n_trials() << "\t"
+				<< estimator.get_threshold_mean() << "\t" << estimator.get_threshold_sd() << "\t"
+				<< estimator.get_slope_mean() << "\t" << estimator.get_slope_sd() << endl;
+			}
+		}
+}
+
+// write one row of the output file from a cell's color (rows) by digit (columns) Target/Masker/Neither table;
+// the other counts are all marginals of the table; with a response timeout, the number of timeouts is in an extra last column,
+// and the proportions are of all trials, including the timeouts
+void Brungart_device::write_output_row(ostream& os, int n_speakers_, int icondition, int isnr, bool tag_n_speakers)
+{
+	double table[3][3];
+	results.get_table(n_speakers_, icondition, isnr, table);
+	double n = results.get_n_trials(n_speakers_, icondition, isnr);
+	double color_counts[3] = {0., 0., 0.};
+	double digit_counts[3] = {0., 0., 0.};
+	for(int icr = 0; icr < 3; icr++)
+		for(int idr = 0; idr < 3; idr++) {
+			color_counts[icr] += table[icr][idr];
+			digit_counts[idr] += table[icr][idr];
+			}
+
+	if(tag_n_speakers)
+		os << n_speakers_ << "\t";
 //		output_file << n_trials << "\t" << masker_genders[condition_index] << "\t" << stream_masking_probs[snr_index] << "\t"
-	output_file << n_trials << "\t" << masking_condition_labels[condition_index] << "\t" << target_snrs[snr_index] << "\t"
-		<< double(n_completely_correct)/n_trials << "\t" << double(n_target_color)/n_trials << "\t" << double(n_masker_color)/n_trials   << "\t" << double(n_neither_color)/n_trials  << "\t" 
-		<< double(n_target_digit)/n_trials  << "\t" << double(n_masker_digit)/n_trials  << "\t" << double(n_neither_digit)/n_trials;
+	os << n << "\t" << org_masking_condition_labels[icondition].substr(0, n_speakers_) << "\t" << results.get_snr(isnr) << "\t"
+		<< table[0][0]/n << "\t" << color_counts[0]/n << "\t" << color_counts[1]/n   << "\t" << color_counts[2]/n  << "\t" 
+		<< digit_counts[0]/n  << "\t" << digit_counts[1]/n  << "\t" << digit_counts[2]/n;
 	for(int icr = 0; icr < 3; icr++) {
 		for(int idr = 0; idr < 3; idr++) {
-			output_file  << "\t" << n_color_digit_table[icr][idr];
+			os  << "\t" << table[icr][idr];
 			}
 		}
-	output_file << endl;
-					
+	if(response_timeout)
+		os << "\t" << results.get_n_timeouts(n_speakers_, icondition, isnr);
+	os << endl;
+}
+
+/* Fork server
+Each line of the jobs file is a complete condition string, which must include its own output=<filename>;
+blank lines and lines starting with // are ignored. Up to fork_max children run at once; each is a copy-on-write
+copy of this process, with the corpus loaded, the rules compiled, and the START and PRESENT_CURSOR steps done.
+A child takes its job's condition string and seed, reseeds the global random number generator from the seed so
+that the model's randomness differs between jobs, and carries on to the first trial. A job without a seed gets
+one drawn here before forking. A child ends its process when its session stops, with its results written, so it
+never goes back to the copy of the host's event loop and user interface it was forked with.
+
+The parent supervises its children from FORK_SERVER delay events rather than waiting in one event for them all,
+so the host must keep running the parent's simulation until it stops by itself after the last child; each
+event waits at most fork_wait_poll_us_c of real time.
+*/
+void Brungart_device::start_fork_server()
+{
+#ifdef FORK_SERVER_AVAILABLE
+	ifstream jobs_file(fork_jobs_filename.c_str());
+	if(!jobs_file)
+		throw Device_exception(this, string("Could not open fork jobs file ") + fork_jobs_filename);
+	fork_jobs.clear();
+	string line;
+	while(getline(jobs_file, line)) {
+		if(line.find_first_not_of(" \t\r") == string::npos || line.compare(line.find_first_not_of(" \t"), 2, "//") == 0)
+			continue;
+		if(line.find("output=") == string::npos)
+			throw Device_exception(this, string("Each fork job must specify output=<filename>: ") + line);
+		if(line.find("fork_jobs=") != string::npos)
+			throw Device_exception(this, string("A fork job can't itself be a fork server: ") + line);
+		fork_jobs.push_back(line);
+		}
+	next_fork_job = 0;
+	fork_child_pids.clear();
+	n_fork_jobs_failed = 0;
+	device_out << processor_info() << "Fork server starting " << fork_jobs.size() << " jobs from " << fork_jobs_filename << endl;
+#else
+	throw Device_exception(this, "Fork server mode requires a Unix system");
+#endif
+}
+
+// collect the children that have finished and start jobs up to the limit; returns true once every job is done,
+// so the parent can stop, and false otherwise, in the child as well as in the parent
+bool Brungart_device::serve_fork_jobs()
+{
+#ifdef FORK_SERVER_AVAILABLE
+	// only the children started here are waited for, so any other child of the process is left to its owner
+	bool any_finished = false;
+	for(int i = 0; i < int(fork_child_pids.size()); ) {
+		int status;
+		pid_t pid = waitpid(fork_child_pids[i], &status, WNOHANG);
+		if(pid == 0 || (pid < 0 && errno == EINTR)) {
+			i++;
+			continue;
+			}
+		if(pid < 0)
+			throw Device_exception(this, "Fork server lost track of its child processes");
+		if(!WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+			n_fork_jobs_failed++;
+			device_out << processor_info() << "Fork server child " << pid << " failed" << endl;
+			}
+		fork_child_pids.erase(fork_child_pids.begin() + i);
+		any_finished = true;
+		}
+	while(next_fork_job < int(fork_jobs.size()) && int(fork_child_pids.size()) < fork_max_children) {
+		int ijob = next_fork_job++;
+		unsigned long job_seed = draw_default_seed();
+		// output still buffered would otherwise be written by the child as well as the parent
+		cout.flush();
+		cerr.flush();
+		clog.flush();
+		fflush(NULL);
+		if(descriptors_file.is_open())
+			descriptors_file.flush();
+		if(trials_file.is_open())
+			trials_file.flush();
+		pid_t pid = fork();
+		if(pid < 0)
+			throw Device_exception(this, "Fork server could not fork");
+		if(pid == 0) {
+			start_forked_job(fork_jobs[ijob], job_seed);
+			return false;
+			}
+		device_out << processor_info() << "Fork server job " << ijob << " pid " << pid << ": " << fork_jobs[ijob] << endl;
+		fork_child_pids.push_back(pid);
+		any_finished = true;
+		}
+	if(fork_child_pids.empty()) {
+		device_out << processor_info() << "Fork server finished " << fork_jobs.size() << " jobs, " << n_fork_jobs_failed << " failed" << endl;
+		return true;
+		}
+	// wait a little in real time if nothing changed, so that a host running the simulation flat out doesn't spin
+	if(!any_finished)
+		usleep(fork_wait_poll_us_c);
+	schedule_delay_event(fork_poll_time_c);
+	return false;
+#else
+	throw Device_exception(this, "Fork server mode requires a Unix system");
+#endif
+}
+
+// in the child: become an ordinary device running this job
+void Brungart_device::start_forked_job(const string& job, unsigned long job_seed)
+{
+	forked_job = true;
+	set_parameter_string(job);
+	if(!seed_specified) {
+		seed = job_seed;
+		seed_specified = true;
+		}
+	get_Random_engine().seed(seed);
+	if(!setup_first_run()) {
+		stop_session();
+		return;
+		}
+	if(surrogate_mode) {
+		run_surrogate();
+		stop_session();
+		return;
+		}
+	set_state(START_TRIAL);
+	schedule_delay_event(0);
+}
+
+// every way the device ends its session comes here, once the results are written
+void Brungart_device::stop_session()
+{
+	if(forked_job)
+		end_forked_job(EXIT_SUCCESS);
+	stop_simulation();
+}
+
+// a forked child's process ends here, after everything it wrote is flushed, since _exit runs no destructors
+// and flushes nothing; the exit status tells the fork server whether the job succeeded
+void Brungart_device::end_forked_job(int exit_status)
+{
+#ifdef FORK_SERVER_AVAILABLE
+	stall_watchdog.stop();
+	if(chrome_trace.is_open()) {
+		set_state(SHUTDOWN);
+		chrome_trace.close();
+		}
+	if(descriptors_file.is_open())
+		descriptors_file.close();
+	if(trials_file.is_open())
+		trials_file.close();
+	cout.flush();
+	cerr.flush();
+	clog.flush();
+	fflush(NULL);
+	_exit(exit_status);
+#endif
+}
+
+// evaluate every run with the closed-form surrogate, using the same stimulus generation and output layout
+// as the simulation, but without presenting anything to the model
+void Brungart_device::run_surrogate()
+{
+	Surrogate_parameters parameters;
+	parameters.load_from_prs_file(get_human_prs_filename());
+	device_out << processor_info() << "Surrogate evaluation with parameters from " << get_human_prs_filename() << endl;
+	Surrogate_evaluator evaluator(parameters, int(colors.size()), int(digits.size()));
+	
+	do {
+		// evaluate each number of speakers in the run as a separate batch
+		vector<int> run_n_speakers = get_run_n_speakers();
+		for(int i = 0; i < run_n_speakers.size(); i++) {
+			for(trial = 0; trial < n_trials; trial++) {
+				setup_trial();
+				if(n_speakers != run_n_speakers[i])
+					continue;
+				create_messages();
+				evaluator.add_trial(messages, n_speakers);
+				}
+			n_speakers = run_n_speakers[i];
+			double table[3][3] = {{0., 0., 0.}, {0., 0., 0.}, {0., 0., 0.}};
+			evaluator.evaluate(table);
+			double n = results.get_n_trials(n_speakers, condition_index, snr_index);
+			for(int icr = 0; icr < 3; icr++)
+				for(int idr = 0; idr < 3; idr++)
+					results.add(n_speakers, condition_index, snr_index, Results_cube::outcome(icr, idr), table[icr][idr]);
+			n = results.get_n_trials(n_speakers, condition_index, snr_index) - n;
+			device_out << "Surrogate trials: " << n << " masker speaker: " << org_masking_condition_labels[condition_index].substr(0, n_speakers)
+				<< " target SNR: " << target_snrs[snr_index] << " P(both correct): " << table[0][0] / n << endl;
+			}
+		trial = 0;
+		} while(!setup_next_run());
 }
 
 
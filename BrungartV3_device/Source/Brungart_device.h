@@ -3,6 +3,9 @@
 
 #include <vector>
 #include <fstream>
+#include <sstream>
+#include <random>
+#include <chrono>
 
 #include "EPICLib/Device_base.h"
 #include "EPICLib/Symbol.h"
@@ -11,6 +14,15 @@
 #include "Response_object.h"
 #include "Message.h"
 #include "CRM_utterance_stats.h"
+#include "CRM_corpus.h"
+#include "Results_cube.h"
+#include "Psychometric_estimator.h"
+#include "Results_cache.h"
+#include "Chrome_trace.h"
+#include "Stall_watchdog.h"
+#include "Utterance_pair_index.h"
+#include "Parameter_race.h"
+#include "Condition_options.h"
 
 namespace GU = Geometry_Utilities;
 #
@@ -85,26 +97,141 @@ private:
 
 	enum State_e {START, PRESENT_CURSOR, START_TRIAL, PRESENT_STIMULUS, 
 		NEXT_WORD, ENABLE_RESPONSE, WAITING_FOR_RESPONSE, 
-		SHUTDOWN};
+		CHANGE_N_SPEAKERS, FORK_SERVER, SHUTDOWN};
 	
 	State_e state;
 	
 	// parameters
 	std::string condition_string;
-	int n_trials;
-	int n_speakers;
-	static const int n_speakers_max_c = 4;
-	static const int n_speaker_conditions_c = 3;
+	int default_n_trials;	// trials per cell unless overridden for the cell
+	int n_trials;			// trials in the current run
+	int n_speakers;			// speakers in the current trial
+	int displayed_n_speakers;	// the number last shown to the model
+	static const int n_speakers_max_c = Condition_options::n_speakers_max_c;
+	static const int n_speaker_conditions_c = Condition_options::n_conditions_c;
 	
 	long probe_targets_delay;
 
+	// per-device randomization and output, so that several devices can run concurrently
+	std::string output_filename;
+	bool seed_specified;
+	unsigned long seed;
+	std::mt19937 random_engine;
+	// if true, evaluate the closed-form surrogate instead of running the model
+	bool surrogate_mode;
+	// if non-empty, serve the condition strings in this file from forked copies of the initialized process
+	std::string fork_jobs_filename;
+	int fork_max_children;
+	bool forked_job;	// this process is a fork server's child, and ends with its session
+	std::vector<std::string> fork_jobs;
+	int next_fork_job;
+	std::vector<int> fork_child_pids;	// the children still running
+	int n_fork_jobs_failed;
+	// each trial's stimulus and timing are drawn from an engine seeded for that trial alone, so any trial can be
+	// replayed by itself; a descriptor of each trial goes to the descriptors file if one is named
+	std::string descriptors_filename;
+	std::ofstream descriptors_file;
+	unsigned long trial_seed;	// seeds the device engine for the current trial
+	unsigned long model_seed;	// reseeds the architecture's engine when the current trial starts, if enabled
+	long trial_start_delay;
+	// if true, reseed the architecture's engine at each trial; the engine is process-wide, so this assumes one device
+	bool seed_model_per_trial;
+	// if true, run only trial replay_k of the replay condition and SNR, traced, and then stop
+	bool replay_mode;
+	int replay_condition;
+	double replay_snr;
+	int replay_k;
+
+	// the cells to run; the masking conditions are indices into org_masking_condition_labels
+	std::vector<int> selected_speakers;		// numbers of speakers, in the order to run them if blocked
+	bool interleave_speakers;				// if true, each run mixes trials with all the selected numbers of speakers
+	std::vector<int> selected_conditions;
+	std::vector<Condition_options::Cell_trials> cell_trials;	// overrides of default_n_trials for particular cells
+	// the sequence of runs for the session, built from the selections at the start
+	struct Run_spec {
+		Run_spec(int condition_index_, int snr_index_) :
+			condition_index(condition_index_), snr_index(snr_index_), identity(0), candidate_index(-1) {}
+		int condition_index;
+		int snr_index;
+		std::vector<int> trial_n_speakers;	// the number of speakers for each trial in the run
+		std::vector<int> trial_bins;		// if stratified, the difficulty bin of each trial's stimulus
+		std::vector<double> trial_weights;	// and the weight its outcome is counted with
+		uint64_t identity;	// a hash of what the run is, which with the seed determines all its random numbers
+		int candidate_index;	// in a race, the parameter set the run is for
+	};
+	std::vector<Run_spec> runs;
+	int run_index;
+	// if true, each trial's SNR is chosen from target_snrs by a psychometric estimator for its speakers and condition
+	bool adaptive_snrs;
+	std::vector<Psychometric_estimator> estimators;	// indexed by (n_speakers - 2) * n_speaker_conditions_c + condition
+	std::ofstream trials_file;						// a line for each adaptive trial
+	// if named, runs whose results are in the cache are not run again, and the results of new runs are added
+	std::string cache_filename;
+	Results_cache cache;
+	uint64_t config_hash;	// everything besides the run itself that determines its results
+	// if positive, keep running rounds of trials, allocated to the cells that need them most, until this many 
+	// seconds after the session starts
+	double deadline_seconds;
+	std::chrono::steady_clock::time_point session_start_time;
+	int round;							// the first round is the trials given in the condition string
+	std::vector<int> round_allocation;	// trials per cell in the current round, indexed like the estimators by SNR within that
+	long n_trials_run;					// in the whole session, for the trial rate
+	// a trial with no response this long after the last word is scored as a timeout; 0 means it waits for the response
+	long response_timeout;
+	int response_token;					// identifies the current trial's timeout
+	bool response_timed_out;			// if so, a late response is ignored
+	// if positive, the session stops with a diagnostic and the results so far if no trial is completed in this many
+	// seconds of wall-clock time; with stall_exit, the process ends if the device doesn't get control within as
+	// long again, which only an unattended run should ask for, since a run paused in the GUI looks the same
+	double stall_seconds;
+	bool stall_exit;
+	Stall_watchdog stall_watchdog;
+	// if positive, each trial's stimulus is drawn from one of this many bins of acoustic difficulty, the bins are
+	// used equally often for each number of speakers in a run, and the outcomes are weighted to the natural mix
+	int stratify_bins;
+	Utterance_pair_index pair_index;
+	// if a race file is named, its candidate parameter sets are run in rounds on the same trials in the cells it has
+	// data for, starting with race_start_trials per cell and doubling each round up to the trials in the condition
+	// string, and the clearly worse half of the survivors is dropped after each round
+	std::string race_filename;
+	Parameter_race race;
+	int race_start_trials;
+	int race_candidate;		// whose parameters are set and whose results are in results, or -1
+	// the random choices that make up a trial's stimulus, target first
+	struct Stimulus_draw {
+		std::vector<int> callsign_indices;
+		std::vector<int> color_indices;
+		std::vector<int> digit_indices;
+		std::vector<int> message_speakers;
+	};
+#ifdef BRUNGART_ALLOCATION_ACCOUNTING
+	long last_reported_rss_kb;
+#endif
+
+	// which trials get traced when device tracing is on
+	Condition_options::Trace_policy_e trace_policy;
+	int trace_interval;				// for TRACE_EVERY_NTH
+	std::string trace_condition;	// for TRACE_CELL, the first two letters of a masking condition label
+	double trace_snr;				// for TRACE_CELL
+	bool trace_trial;				// set at trial start, cleared at scoring
+	std::ostringstream trial_trace;	// TRACE_ERRORS holds the trial's trace here until it is scored
+	bool trace_suspended;			// the device's trace flag is off for an untraced trial
+	// if named, the device states and the words spoken go to this file as spans in Chrome trace-event format
+	std::string chrome_trace_filename;
+	Chrome_trace chrome_trace;
+	long state_entry_time;			// when the current state was entered, in simulated time
+	double state_entry_wall_us;		// and in wall-clock microseconds since the session started
+	std::string state_entry_args;	// the run and trial then
+
 	// stimulus generation	
 	Words_t callsigns;
 	Words_t colors;
 	Words_t digits;
-	std::vector<Speaker> speakers; // speaker parameters
-	// these dimensions are fixed in the CRM corpus
-	CRM_utterance_stats utterance_data[8][8][4][8];
+	std::vector<Speaker> published_speakers; // speaker parameters of the published corpus
+	std::vector<Speaker> speakers; // and of the loaded corpus, which repeat them for any extra talkers
+	// the corpus is the published one unless the condition string names another or a synthetic one
+	std::string corpus_spec;
+	CRM_corpus corpus;
 	
 	// the following are n_speakers in length; first cell is for target, rest for maskers
 	std::vector<Symbol> stream_names;
@@ -119,8 +246,6 @@ private:
 //	Condition_spec_t speaker_genders;
 //  Condition_spec_t speaker_ids;
 
-	std::vector<double> org_target_snrs;
-	std::vector<double> rep_target_snrs;
 	std::vector<double> target_snrs;
 	
 	std::vector<Message> messages;
@@ -140,50 +265,75 @@ private:
 	// display state
 	GU::Point cursor_location;
 	Symbol current_pointed_to_object;
+	// each ply moves the visual cursor, or only the last before the response, or plies at least ply_interval ms apart
+	// and then the last; the pointed-to object is always kept up to date, so scoring is the same
+	Condition_options::Ply_policy_e ply_policy;
+	long ply_interval;				// for PLY_INTERVAL
+	long last_cursor_update_time;
+	bool cursor_update_pending;		// the cursor has moved since it was last shown
+	long n_plies;					// in the current run
+	long n_cursor_updates;
 
 	typedef std::vector<Response_object> Response_objects_t;
 	Response_objects_t response_objects;
 					
 	// data accumulation
-	std::ofstream output_file;		
+	std::string binary_output_filename;
+	// the binary output of earlier sessions, whose counts are added to this session's before it starts
+	std::vector<std::string> merge_filenames;
+	int checkpoint_interval;	// write the output files after this many completed runs; 0 means only at the end
+	int n_runs_completed;
+	Results_cube results;		// outcome counts for every cell, kept for the whole run
 	int trial;
 	int snr_index;
 	int condition_index;
 	long rt;
-	int n_completely_correct;
-	int n_color_only_correct;
-	int n_digit_only_correct;
-	int n_completely_incorrect;
-	int n_masker_both;
-	int n_masker_color_only;
-	int n_masker_digit_only;
-	int n_masker_neither;
-	
-	int n_target_color;
-	int n_masker_color;
-	int n_neither_color;
-	int n_target_digit;
-	int n_masker_digit;
-	int n_neither_digit;
-	
-	int n_color_digit_table[3][3];
 	
 	long stimulus_onset_time;
-    std::string corpus_version_info;
 	
 	// helpers
 	void parse_condition_string();
-	void load_utterance_corpus_data();
+	void build_runs();
+	int get_cell_n_trials(int n_speakers_, int icondition, int isnr) const;
+	double get_elapsed_seconds() const;
+	bool plan_next_round();
+	bool plan_next_race_round();
+	int get_race_budget(int n_full_trials, int round_) const;
+	void select_race_candidate(int icandidate);
+	void write_race_standings();
+	void setup_run();
+	void setup_trial();
+	Psychometric_estimator& get_estimator(int n_speakers_, int icondition);
+	std::vector<int> get_run_n_speakers() const;
+	void seed_trial();
+	int get_cell_trial_index(int itrial) const;
+	void locate_replay_trial();
+	void write_trial_descriptor(std::ostream& os, int icr, int idr);
+	void use_cached_runs();
+	void store_run_in_cache();
+	uint64_t get_cache_key(const Run_spec& run) const;
+	double load_utterance_corpus_data(const std::string& spec, CRM_corpus& new_corpus) const;
+	void use_utterance_corpus(CRM_corpus& new_corpus, const std::string& spec, double load_ms);
+	void fit_vocabulary_to_corpus();
+	int get_published_speaker(int talker, int n_talkers) const;
+	void report_corpus(double load_ms);
 	void present_number_of_speakers();
 	void remove_number_of_speakers();
 	void present_cursor();
+	void show_cursor_location();
 	void signal_trial_start();
 	void reset_for_run();
-	void setup_first_run();
+	bool setup_first_run();
 	bool setup_next_run();
 	void set_parameter(const std::string& proc_name, const std::string& param_name, const std::string& spec, double value);
+	int device_random_int(int range);
+	void set_state(State_e new_state);
 	
 	void create_messages();
+	void draw_stimulus(Stimulus_draw& draw, std::mt19937& engine, int n_speakers_, int icondition) const;
+	double get_difficulty(const Stimulus_draw& draw, int n_speakers_) const;
+	void set_stratification_bins();
+	void assign_strata(Run_spec& run) const;
 	void present_stimulus();
 	void present_next_word();
 	void present_word(const Symbol& source, char stem, const Symbol& word, const Symbol& speaker_gender, const Symbol& speaker_id, double loudness, long duration);
@@ -194,7 +344,29 @@ private:
 	void present_none_response_object();
 	void remove_response_objects();
 	void score_response();
-	void output_statistics();
+	void score_timeout();
+	void record_outcome(int icr, int idr);
+	void handle_response_timeout(const Symbol& token);
+	bool stop_if_stalled();
+	void finish_trial();
+	void start_trial_trace();
+	void emit_trace(const std::string& line);
+	void finish_trial_trace(bool response_in_error);
+	void suspend_trace();
+	void resume_trace();
+	void output_statistics(int n_speakers_);
+	void merge_earlier_results();
+	void write_results();
+	void output_allocation_report();
+	void output_psychometric_fit(int n_speakers_);
+	void write_psychometric_fits(std::ostream& os);
+	void write_output_row(std::ostream& os, int n_speakers_, int icondition, int isnr, bool tag_n_speakers);
+	void run_surrogate();
+	void start_fork_server();
+	bool serve_fork_jobs();
+	void start_forked_job(const std::string& job, unsigned long job_seed);
+	void stop_session();
+	void end_forked_job(int exit_status);
 
 	// rule out default ctor, copy, assignment
 	Brungart_device(const Brungart_device&);
@@ -0,0 +1,121 @@
+/*
+ *  CRM_corpus.cpp
+ *  BrungartV3_device
+ *
+ */
+
+#include "CRM_corpus.h"
+#include "EPICLib/Device_exception.h"
+#include "EPICLib/Assert.h"
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <random>
+#include <limits>
+#include <algorithm>
+
+using namespace std;
+
+// the level of the published corpus that synthetic voices are relative to, in dB, and the lowest pitch drawn, in Hz
+const double synthetic_loudness_level_c = 60.;
+const double synthetic_pitch_min_c = 50.;
+// utterance durations in seconds, about those of the published corpus
+const double synthetic_duration_mean_c = 1.76;
+const double synthetic_duration_sd_c = 0.1;
+
+// the smallest power of ten above every subscript of a dimension
+static int get_place(int n)
+{
+	int place = 10;
+	while(place < n)
+		place *= 10;
+	return place;
+}
+
+CRM_corpus::CRM_corpus() :
+	n_talkers(0), n_callsigns(0), n_colors(0), n_digits(0), talker_place(0), callsign_place(0), color_place(0)
+{
+}
+
+void CRM_corpus::set_dimensions(int n_talkers_, int n_callsigns_, int n_colors_, int n_digits_)
+{
+	if(n_talkers_ <= 0 || n_callsigns_ <= 0 || n_colors_ <= 0 || n_digits_ <= 0)
+		throw Device_exception("CRM corpus dimensions must be positive");
+	n_talkers = n_talkers_;
+	n_callsigns = n_callsigns_;
+	n_colors = n_colors_;
+	n_digits = n_digits_;
+	color_place = get_place(n_digits);
+	callsign_place = color_place * get_place(n_colors);
+	// the utterance ids must fit in an int
+	if(double(callsign_place) * get_place(n_callsigns) * n_talkers > numeric_limits<int>::max())
+		throw Device_exception("CRM corpus is too large for its utterance ids");
+	talker_place = callsign_place * get_place(n_callsigns);
+	utterances.assign(size_t(n_talkers) * n_callsigns * n_colors * n_digits, CRM_utterance_stats());
+}
+
+void CRM_corpus::load(const string& filename)
+{
+	ifstream infile(filename.c_str());
+	if(!infile)
+		throw Device_exception(string("Could not open ") + filename + "!");
+	load(infile, filename);
+}
+
+void CRM_corpus::load(istream& is, const string& name)
+{
+	// the first line has version information
+	getline(is, version_info);
+	if(!is)
+		throw Device_exception(string("Could not read ") + name + "!");
+	int nt = standard_n_talkers_c, nc = standard_n_callsigns_c, nk = standard_n_colors_c, nd = standard_n_digits_c;
+	if((is >> ws).peek() == 'd') {
+		string line, keyword;
+		getline(is, line);
+		istringstream iss(line);
+		if(!(iss >> keyword >> nt >> nc >> nk >> nd) || keyword != "dimensions")
+			throw Device_exception(string("Incorrect dimensions line in ") + name + ": " + line);
+		}
+	set_dimensions(nt, nc, nk, nd);
+	
+	for(int it = 0; it < n_talkers; it++)
+		for(int ic = 0; ic < n_callsigns; ic++)
+			for(int ik = 0; ik < n_colors; ik++)
+				for(int id = 0; id < n_digits; id++) {
+					// read and verify subscripts
+					int spk, cal, clr, dig;
+					if(!(is >> spk >> cal >> clr >> dig))
+						throw Device_exception(string("failure to read utterance subscripts in ") + name);
+					if(spk != it || cal != ic || clr != ik || dig != id)
+						throw Device_exception(string("utterance subscripts out of order in ") + name);
+					if(!(is >> utterances[get_index(it, ic, ik, id)]))
+						throw Device_exception(string("failure to read utterance_stats in ") + name);
+					}
+}
+
+// the dimensions must be positive; the version line records how the corpus was made
+void CRM_corpus::write_synthetic(ostream& os, int n_talkers_, int n_callsigns_, int n_colors_, int n_digits_, 
+	const vector<Voice>& voices, unsigned long seed)
+{
+	Assert(n_talkers_ > 0 && n_callsigns_ > 0 && n_colors_ > 0 && n_digits_ > 0 && !voices.empty());
+	os << "synthetic " << n_talkers_ << 'x' << n_callsigns_ << 'x' << n_colors_ << 'x' << n_digits_ << " seed " << seed << '\n';
+	os << "dimensions " << n_talkers_ << ' ' << n_callsigns_ << ' ' << n_colors_ << ' ' << n_digits_ << '\n';
+	mt19937 engine(seed);
+	normal_distribution<double> unit_normal;
+	for(int it = 0; it < n_talkers_; it++) {
+		const Voice& voice = voices[it % voices.size()];
+		for(int ic = 0; ic < n_callsigns_; ic++)
+			for(int ik = 0; ik < n_colors_; ik++)
+				for(int id = 0; id < n_digits_; id++) {
+					os << it << '\t' << ic << '\t' << ik << '\t' << id << '\t' 
+						<< synthetic_duration_mean_c + synthetic_duration_sd_c * unit_normal(engine);
+					for(int is = 0; is < n_utterance_segments; is++) {
+						double loudness = synthetic_loudness_level_c + voice.loudness_mean + voice.loudness_sd * unit_normal(engine);
+						double pitch = voice.pitch_mean + voice.pitch_sd * unit_normal(engine);
+						os << '\t' << loudness << '\t' << max(pitch, synthetic_pitch_min_c);
+						}
+					os << '\n';
+					}
+		}
+}
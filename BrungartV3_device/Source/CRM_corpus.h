@@ -0,0 +1,92 @@
+/*
+ *  CRM_corpus.h
+ *  BrungartV3_device
+ *
+ */
+
+#ifndef CRM_CORPUS_H
+#define CRM_CORPUS_H
+
+#include "CRM_utterance_stats.h"
+#include <string>
+#include <vector>
+#include <iosfwd>
+#include <cstddef>
+
+/*
+A CRM_corpus holds the statistics of every utterance in a corpus of "Ready <callsign> go to <color> <digit> now"
+sentences, in one flat array indexed by talker, callsign, color, and digit in that order, so its size is set when
+it is loaded rather than compiled in.
+
+The file format is the version line, then optionally a line "dimensions <talkers> <callsigns> <colors> <digits>",
+then a line for each utterance in index order giving its four subscripts and its statistics. Without the dimensions
+line, the corpus is taken to be the published one, 8 talkers, 8 callsigns, 4 colors, and 8 digits.
+
+A synthetic corpus file of any size can be generated, with each segment's loudness and pitch drawn from its
+talker's voice; it is meant for measuring how the costs of a corpus scale with its size, not for fitting data.
+*/
+class CRM_corpus {
+public:
+	static const int standard_n_talkers_c = 8;
+	static const int standard_n_callsigns_c = 8;
+	static const int standard_n_colors_c = 4;
+	static const int standard_n_digits_c = 8;
+
+	// pitch is in Hz; loudness is in dB relative to the level of the published corpus
+	struct Voice {
+		Voice(double pitch_mean_, double pitch_sd_, double loudness_mean_, double loudness_sd_) :
+			pitch_mean(pitch_mean_), pitch_sd(pitch_sd_), loudness_mean(loudness_mean_), loudness_sd(loudness_sd_) {}
+		double pitch_mean;
+		double pitch_sd;
+		double loudness_mean;
+		double loudness_sd;
+	};
+
+	CRM_corpus();
+	// throws Device_exception if the file can't be read; the name is used in the error messages
+	void load(const std::string& filename);
+	void load(std::istream& is, const std::string& name);
+	// write a corpus in the file format; talker t speaks with voices[t % voices.size()], and the same seed
+	// gives the same corpus
+	static void write_synthetic(std::ostream& os, int n_talkers_, int n_callsigns_, int n_colors_, int n_digits_, 
+		const std::vector<Voice>& voices, unsigned long seed);
+
+	const std::string& get_version_info() const
+		{return version_info;}
+	int get_n_talkers() const
+		{return n_talkers;}
+	int get_n_callsigns() const
+		{return n_callsigns;}
+	int get_n_colors() const
+		{return n_colors;}
+	int get_n_digits() const
+		{return n_digits;}
+	int get_n_utterances() const
+		{return int(utterances.size());}
+	std::size_t get_memory_size() const
+		{return utterances.capacity() * sizeof(CRM_utterance_stats);}
+
+	int get_index(int talker, int callsign, int color, int digit) const
+		{return ((talker * n_callsigns + callsign) * n_colors + color) * n_digits + digit;}
+	const CRM_utterance_stats& get(int talker, int callsign, int color, int digit) const
+		{return utterances[get_index(talker, callsign, color, digit)];}
+	// the subscripts written in decimal fields just wide enough for each dimension, which for the published corpus
+	// is talker * 1000 + callsign * 100 + color * 10 + digit
+	int get_utterance_id(int talker, int callsign, int color, int digit) const
+		{return talker * talker_place + callsign * callsign_place + color * color_place + digit;}
+
+private:
+	std::string version_info;
+	int n_talkers;
+	int n_callsigns;
+	int n_colors;
+	int n_digits;
+	int talker_place;
+	int callsign_place;
+	int color_place;
+	std::vector<CRM_utterance_stats> utterances;
+
+	void set_dimensions(int n_talkers_, int n_callsigns_, int n_colors_, int n_digits_);
+};
+
+#endif
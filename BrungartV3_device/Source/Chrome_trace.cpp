@@ -0,0 +1,77 @@
+/*
+ *  Chrome_trace.cpp
+ *  BrungartV3_device
+ *
+ */
+
+#include "Chrome_trace.h"
+
+#include <iomanip>
+
+using namespace std;
+
+bool Chrome_trace::open(const string& filename)
+{
+	close();
+	file.open(filename.c_str());
+	if(!file)
+		return false;
+	file << "[" << fixed << setprecision(3);
+	n_events = 0;
+	return true;
+}
+
+void Chrome_trace::close()
+{
+	if(!file.is_open())
+		return;
+	file << "\n]\n";
+	file.close();
+}
+
+void Chrome_trace::name_track(int pid, int tid, const string& process_name, const string& thread_name)
+{
+	start_event();
+	file << "{\"ph\":\"M\",\"name\":\"process_name\",\"pid\":" << pid << ",\"tid\":" << tid 
+		<< ",\"args\":{\"name\":" << quote(process_name) << "}}";
+	start_event();
+	file << "{\"ph\":\"M\",\"name\":\"thread_name\",\"pid\":" << pid << ",\"tid\":" << tid 
+		<< ",\"args\":{\"name\":" << quote(thread_name) << "}}";
+}
+
+void Chrome_trace::add_span(int pid, int tid, const string& name, const string& category, 
+	double start_us, double duration_us, const string& args)
+{
+	start_event();
+	file << "{\"ph\":\"X\",\"name\":" << quote(name) << ",\"cat\":" << quote(category) 
+		<< ",\"pid\":" << pid << ",\"tid\":" << tid << ",\"ts\":" << start_us << ",\"dur\":" << duration_us;
+	if(!args.empty())
+		file << ",\"args\":{" << args << "}";
+	file << "}";
+}
+
+void Chrome_trace::start_event()
+{
+	if(n_events++)
+		file << ",";
+	file << "\n";
+}
+
+// the names written here are plain text, so only quotes, backslashes, and control characters need escaping
+string Chrome_trace::quote(const string& s)
+{
+	string result("\"");
+	for(int i = 0; i < s.size(); i++) {
+		char c = s[i];
+		if(c == '"' || c == '\\') {
+			result += '\\';
+			result += c;
+			}
+		else if(static_cast<unsigned char>(c) < 0x20)
+			result += ' ';
+		else
+			result += c;
+		}
+	result += '"';
+	return result;
+}
@@ -0,0 +1,49 @@
+/*
+ *  Chrome_trace.h
+ *  BrungartV3_device
+ *
+ */
+
+#ifndef CHROME_TRACE_H
+#define CHROME_TRACE_H
+
+#include <string>
+#include <fstream>
+
+/*
+A Chrome_trace writes a file in the Chrome trace-event JSON format (a JSON array of event objects), which the
+Chrome trace viewer and Perfetto can open. Each event is a span on a track, identified by a process and thread
+id; times are in microseconds. Events are written one per line as they are added, and a viewer accepts the
+array without its closing bracket, so the file is usable even if the run is cut short.
+*/
+class Chrome_trace {
+public:
+	Chrome_trace() : n_events(0)
+		{}
+	~Chrome_trace()
+		{close();}
+	// returns false if the file could not be opened
+	bool open(const std::string& filename);
+	bool is_open() const
+		{return file.is_open();}
+	// finish the array and close the file
+	void close();
+
+	// give a track names to show in the viewer
+	void name_track(int pid, int tid, const std::string& process_name, const std::string& thread_name);
+	// a span with a start and duration; args, if not empty, are the members of a JSON object, e.g. "\"trial\":3"
+	void add_span(int pid, int tid, const std::string& name, const std::string& category, 
+		double start_us, double duration_us, const std::string& args = "");
+
+private:
+	std::ofstream file;
+	long n_events;
+
+	void start_event();
+	static std::string quote(const std::string& s);
+
+	Chrome_trace(const Chrome_trace&);
+	Chrome_trace& operator= (const Chrome_trace&);
+};
+
+#endif
@@ -0,0 +1,387 @@
+/*
+ *  Condition_options.cpp
+ *  BrungartV3_device
+ *
+ */
+
+#include "Condition_options.h"
+#include "EPICLib/Device_exception.h"
+
+#include <sstream>
+#include <algorithm>
+
+using namespace std;
+
+const long timeout_time_c = 2000;	// time between last word presentation and time-out on waiting for response, for timeout=default
+// default candidate SNRs for adaptive placement, covering both the rep and org ranges
+const double adaptive_snr_min_c = -24.;
+const double adaptive_snr_max_c = 18.;
+const double adaptive_snr_step_c = 1.;
+// rep is the snr range in the Brungart replication experiment; org is the snr range of the original 2001 experiment
+const double rep_target_snrs_c[] = {-18, -15, -12, -9, -6, -3, 0, 3, 6, 9};
+const double org_target_snrs_c[] = {-12, -9, -6, -3, 0, +3, +6, +9, +12, +15};
+// stratified sampling: the bins if not given and the most allowed
+const int default_stratify_bins_c = 4;
+const int max_stratify_bins_c = 16;
+// by default a race starts each cell with this fraction of the trials in the condition string, but at least the minimum
+const int race_start_divisor_c = 8;
+const int min_race_start_trials_c = 2;
+// in the order of the masking conditions
+const char * const condition_labels_c[Condition_options::n_conditions_c] = {"TD", "TS", "TT"};
+
+const char * const usage_c =
+	"\n Should be: number of trials followed by number of speakers, rep or org, then optional seed=<n> output=<filename> binary_output=<filename> checkpoint=<n>"
+	" merge=<filename>[,...]"
+	" speakers=<n>[,...] order=blocked|interleaved conditions=<TD|TS|TT>[,...] snrs=<snr>[,...] trials=<TD|TS|TT>:<snr>:<n>[,...]"
+	" snr_placement=fixed|adaptive mode=simulate|surrogate fork_jobs=<filename> fork_max=<n>"
+	" trace=all|every:<n>|errors|cell:<TD|TS|TT>:<snr> descriptors=<filename> replay=<TD|TS|TT>:<snr>:<k> model_seeding=shared|trial cache=<filename>"
+	" deadline=<seconds> chrome_trace=<filename> timeout=<ms>|default stall=<seconds>[:exit]"
+	" sampling=random|stratified[:<bins>] race=<filename> race_start=<n> ply=each|final|interval:<ms> corpus=<filename>|synthetic:<talkers>x<callsigns>x<colors>x<digits>[:<filename>]"
+	"\n replay and model_seeding=trial reseed the architecture's random engine, which all devices in the process share,"
+	" so they assume a single device per process; a replay repeats the model's randomness only if the run used model_seeding=trial,"
+	" and a simulated run with cache needs model_seeding=trial";
+
+Condition_options::Condition_options() :
+	n_trials(0), interleave_speakers(false), adaptive_snrs(false), surrogate_mode(false), seed_specified(false), seed(0),
+	seed_model_per_trial(false), checkpoint_interval(0), fork_max_children(1), race_start_trials(0), deadline_seconds(0.),
+	response_timeout(0), stall_seconds(0.), stall_exit(false), stratify_bins(0), ply_policy(PLY_EACH), ply_interval(0),
+	trace_policy(TRACE_ALL), trace_interval(1), trace_snr(0.), replay_mode(false)
+{
+	replay_cell.condition_index = 0;
+	replay_cell.snr = 0.;
+	replay_cell.n_trials = 0;
+}
+
+// the settings are read into a fresh object, so a string that turns out to be incorrect leaves this one as it was
+void Condition_options::parse(const string& condition_string)
+{
+	// build an error message string in case we need it
+	string error_msg(condition_string);
+	error_msg += usage_c;
+	istringstream iss(condition_string);
+	int nt;
+	iss >> nt;
+	// do all error checks before last read
+	if(!iss)
+		throw Device_exception(string("Incorrect condition string: ") + error_msg);
+	if(nt <= 0)
+		throw Device_exception(string("Number of trials must be positive: ") + error_msg);
+	int ns;
+	iss >> ns;
+	if(!iss)
+		throw Device_exception(string("Incorrect condition string: ") + error_msg);
+	if(ns > n_speakers_max_c || ns < 2)
+		throw Device_exception(string("Number of speakers must be >= 2, <=4: ") + error_msg);
+    string version;
+    iss >> version;
+	if(!iss)
+		throw Device_exception(string("Incorrect condition string: ") + error_msg);
+    if (version != "rep" && version != "org")
+		throw Device_exception(string("version must be \"rep\" or \"org\": ") + error_msg);
+
+	// optional name=value settings follow; each device running in the same process
+	// should be given its own seed and output file
+	Condition_options o;
+	o.n_trials = nt;
+	string trace_spec = "all";
+	string option;
+	while(iss >> option) {
+		string::size_type eq_pos = option.find('=');
+		if(eq_pos == string::npos || eq_pos == 0 || eq_pos == option.size() - 1)
+			throw Device_exception(string("Option must be name=value: ") + option + "\n" + error_msg);
+		string name = option.substr(0, eq_pos);
+		istringstream value_iss(option.substr(eq_pos + 1));
+		if(name == "seed") {
+			if(!(value_iss >> o.seed) || !value_iss.eof())
+				throw Device_exception(string("seed must be a non-negative integer: ") + error_msg);
+			o.seed_specified = true;
+			}
+		else if(name == "output") {
+			o.output_filename = value_iss.str();
+			}
+		else if(name == "binary_output") {
+			o.binary_output_filename = value_iss.str();
+			}
+		else if(name == "merge") {
+			string item;
+			while(getline(value_iss, item, ','))
+				o.merge_filenames.push_back(item);
+			if(find(o.merge_filenames.begin(), o.merge_filenames.end(), string()) != o.merge_filenames.end())
+				throw Device_exception(string("merge must be a comma-separated list of binary output files: ") + error_msg);
+			}
+		else if(name == "checkpoint") {
+			if(!(value_iss >> o.checkpoint_interval) || !value_iss.eof() || o.checkpoint_interval < 0)
+				throw Device_exception(string("checkpoint must be a non-negative number of runs: ") + error_msg);
+			}
+		else if(name == "mode") {
+			if(value_iss.str() != "simulate" && value_iss.str() != "surrogate")
+				throw Device_exception(string("mode must be \"simulate\" or \"surrogate\": ") + error_msg);
+			o.surrogate_mode = (value_iss.str() == "surrogate");
+			}
+		else if(name == "trace") {
+			trace_spec = value_iss.str();
+			}
+		else if(name == "fork_jobs") {
+			o.fork_jobs_filename = value_iss.str();
+			}
+		else if(name == "fork_max") {
+			if(!(value_iss >> o.fork_max_children) || !value_iss.eof() || o.fork_max_children <= 0)
+				throw Device_exception(string("fork_max must be a positive number of processes: ") + error_msg);
+			}
+		else if(name == "speakers") {
+			string item;
+			while(getline(value_iss, item, ',')) {
+				istringstream item_iss(item);
+				int count;
+				if(!(item_iss >> count) || !item_iss.eof() || count > n_speakers_max_c || count < 2)
+					throw Device_exception(string("speakers must be a comma-separated list of numbers >= 2, <= 4: ") + error_msg);
+				if(find(o.speaker_counts.begin(), o.speaker_counts.end(), count) == o.speaker_counts.end())
+					o.speaker_counts.push_back(count);
+				}
+			}
+		else if(name == "order") {
+			if(value_iss.str() != "blocked" && value_iss.str() != "interleaved")
+				throw Device_exception(string("order must be \"blocked\" or \"interleaved\": ") + error_msg);
+			o.interleave_speakers = (value_iss.str() == "interleaved");
+			}
+		else if(name == "snr_placement") {
+			if(value_iss.str() != "fixed" && value_iss.str() != "adaptive")
+				throw Device_exception(string("snr_placement must be \"fixed\" or \"adaptive\": ") + error_msg);
+			o.adaptive_snrs = (value_iss.str() == "adaptive");
+			}
+		else if(name == "conditions") {
+			string label;
+			while(getline(value_iss, label, ',')) {
+				int ic = get_condition_index(label);
+				if(ic < 0)
+					throw Device_exception(string("conditions must be TD, TS, or TT: ") + error_msg);
+				if(find(o.conditions.begin(), o.conditions.end(), ic) == o.conditions.end())
+					o.conditions.push_back(ic);
+				}
+			}
+		else if(name == "snrs") {
+			string item;
+			while(getline(value_iss, item, ',')) {
+				istringstream item_iss(item);
+				double snr;
+				if(!(item_iss >> snr) || !item_iss.eof())
+					throw Device_exception(string("snrs must be a comma-separated list of numbers: ") + error_msg);
+				if(find(o.snrs.begin(), o.snrs.end(), snr) != o.snrs.end())
+					throw Device_exception(string("snrs must not repeat a value: ") + error_msg);
+				o.snrs.push_back(snr);
+				}
+			}
+		else if(name == "trials") {
+			string item;
+			while(getline(value_iss, item, ',')) {
+				istringstream item_iss(item);
+				string label;
+				char colon;
+				Cell_trials ct;
+				getline(item_iss, label, ':');
+				ct.condition_index = get_condition_index(label);
+				if(ct.condition_index < 0 || !(item_iss >> ct.snr >> colon >> ct.n_trials) || colon != ':'
+					|| !item_iss.eof() || ct.n_trials < 0)
+					throw Device_exception(string("trials must be <TD|TS|TT>:<snr>:<n>, n >= 0: ") + error_msg);
+				o.cell_trials.push_back(ct);
+				}
+			}
+		else if(name == "descriptors") {
+			o.descriptors_filename = value_iss.str();
+			}
+		else if(name == "cache") {
+			o.cache_filename = value_iss.str();
+			}
+		else if(name == "timeout") {
+			if(value_iss.str() == "default")
+				o.response_timeout = timeout_time_c;
+			else if(!(value_iss >> o.response_timeout) || !value_iss.eof() || o.response_timeout <= response_enable_delay_time_c)
+				throw Device_exception(string("timeout must be a number of ms after the last word, longer than the response enable delay: ") + error_msg);
+			}
+		else if(name == "stall") {
+			string how;
+			if(!(value_iss >> o.stall_seconds) || o.stall_seconds <= 0.
+				|| (!value_iss.eof() && (!getline(value_iss, how) || how != ":exit")))
+				throw Device_exception(string("stall must be a positive number of seconds, optionally followed by :exit: ") + error_msg);
+			o.stall_exit = !how.empty();
+			}
+		else if(name == "sampling") {
+			string sampling;
+			getline(value_iss, sampling, ':');
+			if(sampling == "random" && value_iss.eof())
+				o.stratify_bins = 0;
+			else if(sampling == "stratified" && value_iss.eof())
+				o.stratify_bins = default_stratify_bins_c;
+			else if(sampling != "stratified" || !(value_iss >> o.stratify_bins) || !value_iss.eof()
+				|| o.stratify_bins < 2 || o.stratify_bins > max_stratify_bins_c)
+				throw Device_exception(string("sampling must be random, stratified, or stratified:<bins>, 2 <= bins <= 16: ") + error_msg);
+			}
+		else if(name == "ply") {
+			string policy;
+			getline(value_iss, policy, ':');
+			if(policy == "each" && value_iss.eof())
+				o.ply_policy = PLY_EACH;
+			else if(policy == "final" && value_iss.eof())
+				o.ply_policy = PLY_FINAL;
+			else if(policy == "interval" && (value_iss >> o.ply_interval) && value_iss.eof() && o.ply_interval > 0)
+				o.ply_policy = PLY_INTERVAL;
+			else
+				throw Device_exception(string("ply must be each, final, or interval:<ms>, ms > 0: ") + error_msg);
+			}
+		else if(name == "race") {
+			o.race_filename = value_iss.str();
+			}
+		else if(name == "race_start") {
+			if(!(value_iss >> o.race_start_trials) || !value_iss.eof() || o.race_start_trials < min_race_start_trials_c)
+				throw Device_exception(string("race_start must be a number of trials, at least 2: ") + error_msg);
+			}
+		else if(name == "corpus") {
+			o.corpus_spec = value_iss.str();
+			}
+		else if(name == "chrome_trace") {
+			o.chrome_trace_filename = value_iss.str();
+			}
+		else if(name == "deadline") {
+			if(!(value_iss >> o.deadline_seconds) || !value_iss.eof() || o.deadline_seconds <= 0.)
+				throw Device_exception(string("deadline must be a positive number of seconds: ") + error_msg);
+			}
+		else if(name == "model_seeding") {
+			if(value_iss.str() == "shared")
+				o.seed_model_per_trial = false;
+			else if(value_iss.str() == "trial")
+				o.seed_model_per_trial = true;
+			else
+				throw Device_exception(string("model_seeding must be shared or trial: ") + error_msg);
+			}
+		else if(name == "replay") {
+			// the same form as a trials item, but the number is the index of the trial in the cell
+			string label;
+			char colon;
+			getline(value_iss, label, ':');
+			o.replay_cell.condition_index = get_condition_index(label);
+			if(o.replay_cell.condition_index < 0 || !(value_iss >> o.replay_cell.snr >> colon >> o.replay_cell.n_trials)
+				|| colon != ':' || !value_iss.eof() || o.replay_cell.n_trials < 0)
+				throw Device_exception(string("replay must be <TD|TS|TT>:<snr>:<k>, k >= 0: ") + error_msg);
+			o.replay_mode = true;
+			}
+		else
+			throw Device_exception(string("Unknown option: ") + name + "\n" + error_msg);
+		}
+
+	bool adaptive = o.adaptive_snrs;
+	bool surrogate = o.surrogate_mode;
+	bool replay = o.replay_mode;
+	bool cache = !o.cache_filename.empty();
+	bool race = !o.race_filename.empty();
+	// in adaptive placement, the number of trials is per condition and the SNRs are the candidates
+	if(adaptive && surrogate)
+		throw Device_exception(string("snr_placement=adaptive needs simulated responses, not mode=surrogate: ") + error_msg);
+	if(adaptive && !o.cell_trials.empty())
+		throw Device_exception(string("trials can't be specified per cell with snr_placement=adaptive: ") + error_msg);
+	// an adaptive run's results include the estimator state, which the cache doesn't hold
+	if(adaptive && cache)
+		throw Device_exception(string("cache can't be used with snr_placement=adaptive: ") + error_msg);
+	// with a shared engine, the model's randomness depends on everything simulated before in the process,
+	// so a simulated run's results follow from its cache key only if the model is reseeded for each trial
+	if(cache && !surrogate && !o.seed_model_per_trial)
+		throw Device_exception(string("cache needs model_seeding=trial, unless mode=surrogate: ") + error_msg);
+	// a deadline session's later rounds depend on how fast it runs, so they can't be cached or replayed
+	if(o.deadline_seconds > 0. && (adaptive || surrogate || cache || replay))
+		throw Device_exception(string("deadline can't be combined with snr_placement=adaptive, mode=surrogate, cache, or replay: ") + error_msg);
+	// a replay must reproduce the same session plan, so it needs the seed, and the trial's stimulus can't depend on earlier responses
+	if(replay && !o.seed_specified)
+		throw Device_exception(string("replay needs the seed of the run being replayed: ") + error_msg);
+	if(replay && (adaptive || surrogate || !o.fork_jobs_filename.empty()))
+		throw Device_exception(string("replay can't be combined with snr_placement=adaptive, mode=surrogate, or fork_jobs: ") + error_msg);
+	// the surrogate doesn't weight its trials, and an adaptive run has no fixed trials per speaker count to stratify
+	if(o.stratify_bins && (adaptive || surrogate))
+		throw Device_exception(string("sampling=stratified can't be combined with snr_placement=adaptive or mode=surrogate: ") + error_msg);
+	// a race compares candidates on the same trials, which adaptive placement, the surrogate, a deadline, the cache,
+	// or a replay would each change
+	if(race && (adaptive || surrogate || o.deadline_seconds > 0. || cache || replay))
+		throw Device_exception(string("race can't be combined with snr_placement=adaptive, mode=surrogate, deadline, cache, or replay: ") + error_msg);
+	if(!race && o.race_start_trials)
+		throw Device_exception(string("race_start needs a race file: ") + error_msg);
+	// merged counts would be missing from an adaptive run's estimators and a race's candidates, outside the
+	// trial a replay repeats, merged again by every forked job, and stored in the cache as if they were a run's
+	if(!o.merge_filenames.empty() && (adaptive || race || replay || !o.fork_jobs_filename.empty() || cache))
+		throw Device_exception(string("merge can't be combined with snr_placement=adaptive, race, replay, fork_jobs, or cache: ") + error_msg);
+
+	// the adaptive candidates, or a custom SNR list, replace the ladder for the version
+	if(adaptive && o.snrs.empty()) {
+		for(double snr = adaptive_snr_min_c; snr <= adaptive_snr_max_c; snr += adaptive_snr_step_c)
+			o.snrs.push_back(snr);
+		}
+	if(o.snrs.empty()) {
+		if(version == "rep")
+			o.snrs.assign(rep_target_snrs_c, rep_target_snrs_c + sizeof(rep_target_snrs_c) / sizeof(rep_target_snrs_c[0]));
+		else if(version == "org")
+			o.snrs.assign(org_target_snrs_c, org_target_snrs_c + sizeof(org_target_snrs_c) / sizeof(org_target_snrs_c[0]));
+		}
+	for(int i = 0; i < int(o.cell_trials.size()); i++) {
+		if(find(o.snrs.begin(), o.snrs.end(), o.cell_trials[i].snr) == o.snrs.end())
+			throw Device_exception(string("trials specifies an SNR that is not run: ") + error_msg);
+		}
+	if(replay && find(o.snrs.begin(), o.snrs.end(), o.replay_cell.snr) == o.snrs.end())
+		throw Device_exception(string("replay specifies an SNR that is not run: ") + error_msg);
+	// the conditions are always run in their standard order
+	if(o.conditions.empty()) {
+		for(int ic = 0; ic < n_conditions_c; ic++)
+			o.conditions.push_back(ic);
+		}
+	sort(o.conditions.begin(), o.conditions.end());
+	// a list of speaker counts replaces the single number
+	if(o.speaker_counts.empty())
+		o.speaker_counts.push_back(ns);
+	if(race && !o.race_start_trials)
+		o.race_start_trials = max(nt / race_start_divisor_c, min_race_start_trials_c);
+	// the replayed trial is always traced
+	o.parse_trace_policy(replay ? string("all") : trace_spec, error_msg);
+	*this = o;
+}
+
+int Condition_options::get_condition_index(const string& label)
+{
+	for(int ic = 0; ic < n_conditions_c; ic++)
+		if(label == condition_labels_c[ic])
+			return ic;
+	return -1;
+}
+
+// trace=all traces every trial; every:<n> traces one trial in n; errors traces only trials whose color or digit
+// response was a masker or neither; cell:<condition>:<snr> traces only trials in that condition and SNR.
+// The policy applies to the device's trace; the architecture's processors trace under their own settings
+void Condition_options::parse_trace_policy(const string& spec, const string& error_msg)
+{
+	string policy_error = string("trace must be all, every:<n>, errors, or cell:<TD|TS|TT>:<snr>: ") + error_msg;
+	istringstream iss(spec);
+	string policy;
+	getline(iss, policy, ':');
+	if(policy == "all" && iss.eof()) {
+		trace_policy = TRACE_ALL;
+		}
+	else if(policy == "errors" && iss.eof()) {
+		trace_policy = TRACE_ERRORS;
+		}
+	else if(policy == "every") {
+		int interval;
+		if(!(iss >> interval) || !iss.eof() || interval <= 0)
+			throw Device_exception(policy_error);
+		trace_policy = TRACE_EVERY_NTH;
+		trace_interval = interval;
+		}
+	else if(policy == "cell") {
+		string condition;
+		double snr;
+		getline(iss, condition, ':');
+		if(get_condition_index(condition) < 0)
+			throw Device_exception(policy_error);
+		if(!(iss >> snr) || !iss.eof())
+			throw Device_exception(policy_error);
+		trace_policy = TRACE_CELL;
+		trace_condition = condition;
+		trace_snr = snr;
+		}
+	else
+		throw Device_exception(policy_error);
+}
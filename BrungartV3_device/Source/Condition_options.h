@@ -0,0 +1,85 @@
+/*
+ *  Condition_options.h
+ *  BrungartV3_device
+ *
+ */
+
+#ifndef CONDITION_OPTIONS_H
+#define CONDITION_OPTIONS_H
+
+#include <string>
+#include <vector>
+
+/*
+Condition_options reads a Brungart_device condition string: the number of trials, the number of speakers, and
+rep or org, followed by optional name=value settings. Each value is checked as it is read, and then the rules
+about which settings can't be combined; the first problem found throws a Device_exception that names it and
+gives the condition string and the usage. Settings that follow from others are filled in, such as the SNR ladder
+for the version, or the masking conditions if none are selected. Only the text is checked here; the device loads
+any corpus or race file named and checks it against these settings before it puts any of them to use.
+*/
+class Condition_options {
+public:
+	static const int n_speakers_max_c = 4;
+	static const int n_conditions_c = 3;
+	// time between last word presentation and enabling responses, which a response timeout must be longer than
+	static const long response_enable_delay_time_c = 500;
+
+	enum Trace_policy_e {TRACE_ALL, TRACE_EVERY_NTH, TRACE_ERRORS, TRACE_CELL};
+	enum Ply_policy_e {PLY_EACH, PLY_FINAL, PLY_INTERVAL};
+	// a masking condition and SNR with a number of trials, or for a replay, the index of a trial in the cell
+	struct Cell_trials {
+		int condition_index;
+		double snr;
+		int n_trials;
+	};
+
+	Condition_options();
+	// replace the settings with those in the condition string; throws Device_exception if it is incorrect
+	void parse(const std::string& condition_string);
+
+	// the index of a two-letter masking condition label, TD, TS, or TT, or -1 if it is not one of them
+	static int get_condition_index(const std::string& label);
+
+	int n_trials;						// per cell, unless overridden by cell_trials
+	std::vector<int> speaker_counts;	// in the order given, without repeats
+	bool interleave_speakers;
+	std::vector<int> conditions;		// in their standard order
+	std::vector<double> snrs;
+	std::vector<Cell_trials> cell_trials;
+	bool adaptive_snrs;
+	bool surrogate_mode;
+	bool seed_specified;
+	unsigned long seed;
+	bool seed_model_per_trial;
+	std::string output_filename;		// empty if not given, here and for the other filenames
+	std::string binary_output_filename;
+	std::vector<std::string> merge_filenames;
+	int checkpoint_interval;
+	std::string fork_jobs_filename;
+	int fork_max_children;
+	std::string descriptors_filename;
+	std::string cache_filename;
+	std::string chrome_trace_filename;
+	std::string corpus_spec;
+	std::string race_filename;
+	int race_start_trials;				// filled in if there is a race file
+	double deadline_seconds;			// 0 if none
+	long response_timeout;				// 0 if none
+	double stall_seconds;				// 0 if none
+	bool stall_exit;
+	int stratify_bins;					// 0 for random sampling
+	Ply_policy_e ply_policy;
+	long ply_interval;					// for PLY_INTERVAL
+	Trace_policy_e trace_policy;		// the replayed trial is always traced
+	int trace_interval;					// for TRACE_EVERY_NTH
+	std::string trace_condition;		// for TRACE_CELL, a two-letter masking condition label
+	double trace_snr;					// for TRACE_CELL
+	bool replay_mode;
+	Cell_trials replay_cell;
+
+private:
+	void parse_trace_policy(const std::string& spec, const std::string& error_msg);
+};
+
+#endif
@@ -27,21 +27,18 @@ namespace GU = Geometry_Utilities;
 using namespace std;
 
 
-vector<long> Message::durations;
-Words_t Message::skeleton;
-
 Message::Message() : device_ptr(0)
 {
 		initialize();
 }
 
 Message::Message(Device_base * device_ptr_, const Symbol& stream_name_, const Symbol& speaker_gender_, const Symbol& speaker_id_, 
-        int talker_idx_, int callsign_idx_, int color_idx_, int digit_idx_,
+        int talker_idx_, int callsign_idx_, int color_idx_, int digit_idx_, int utterance_id_,
 		const CRM_utterance_stats& utterance_stats,
 		double baseline_loudness,
 		const Symbol& callsign_, const Symbol& color_, const Symbol& digit_) :
 	device_ptr(device_ptr_), stream_name(stream_name_), speaker_gender(speaker_gender_), speaker_id(speaker_id_), 
-    talker_idx(talker_idx_), callsign_idx(callsign_idx_), color_idx(color_idx_), digit_idx(digit_idx_),
+    talker_idx(talker_idx_), callsign_idx(callsign_idx_), color_idx(color_idx_), digit_idx(digit_idx_), utterance_id(utterance_id_),
 	callsign(callsign_), color(color_), digit(digit_)
 {
 		initialize();
@@ -52,7 +49,7 @@ Message::Message(Device_base * device_ptr_, const Symbol& stream_name_, const Sy
 //		long segment_duration = long(utterance_stats.duration * 1000. / 6.); // duration of each segment in ms
 		
 		// generate loudnesses, pitches, and durations
-		for(int i = 0; i < skeleton.size(); i++) {
+		for(int i = 0; i < get_skeleton().size(); i++) {
 			// force loudness to be the same value with no speaker/utterance variation
 //			loudnesses.push_back(60.0 + baseline_loudness);
 			loudnesses.push_back(utterance_stats.loudnesses[i] + baseline_loudness);
@@ -77,49 +74,50 @@ Message::Message(Device_base * device_ptr_, const Symbol& stream_name_, const Sy
 
 }
 
-// this version follows Greg's 6-beat analysis by grouping "go" and "to" together into "goto"
 void Message::initialize()
 {
-	if(skeleton.empty()) {
-		// a skeleton for the message
-		skeleton.push_back(Symbol("ready"));	//0
-		skeleton.push_back(Symbol("callsign")); //1
-		skeleton.push_back(Symbol("goto"));		//2
-		skeleton.push_back(Symbol("color"));	//3
-		skeleton.push_back(Symbol("digit"));	//4
-		skeleton.push_back(Symbol("now"));		//5
-		}
-		
-	if(durations.empty()) {
-			
-		// this constant is a value from Greg's corpus statistics of 5/14/2012
-		// it is the average utterance duration across the 2048 utterances in the corpus
-//		double mean_utterance_duration_c = 1.761337891; // crmstats_v15
-		double mean_utterance_duration_c = 1.760583496;	// crmstats_wdseg_v1
-		long segment_duration = long(mean_utterance_duration_c * 1000. / 6.); // duration of each segment in ms
-		// message word durations
-		durations.push_back(segment_duration);
-		durations.push_back(segment_duration);
-		durations.push_back(segment_duration);
-		durations.push_back(segment_duration);
-		durations.push_back(segment_duration);
-		durations.push_back(segment_duration);
-		}
-	Assert(skeleton.size() == durations.size());
+	message = get_skeleton();
+}
 
-	message = skeleton;
+// this version follows Greg's 6-beat analysis by grouping "go" and "to" together into "goto"
+// C++11 guarantees that a function-local static is initialized exactly once, even with concurrent callers
+const Words_t& Message::get_skeleton()
+{
+	// a skeleton for the message
+	static const Words_t skeleton = {
+		Symbol("ready"),	//0
+		Symbol("callsign"), //1
+		Symbol("goto"),		//2
+		Symbol("color"),	//3
+		Symbol("digit"),	//4
+		Symbol("now")		//5
+		};
+	return skeleton;
+}
+
+const vector<long>& Message::get_durations()
+{
+	// this constant is a value from Greg's corpus statistics of 5/14/2012
+	// it is the average utterance duration across the 2048 utterances in the corpus
+//	double mean_utterance_duration_c = 1.761337891; // crmstats_v15
+	const double mean_utterance_duration_c = 1.760583496;	// crmstats_wdseg_v1
+	const long segment_duration = long(mean_utterance_duration_c * 1000. / 6.); // duration of each segment in ms
+	// message word durations
+	static const vector<long> durations(6, segment_duration);
+	Assert(get_skeleton().size() == durations.size());
+	return durations;
 }
 
 // present the  word
 void Message::present_word(int trial, int word_counter)
 {
-	Assert(word_counter >= 0 && word_counter < skeleton.size());
+	Assert(word_counter >= 0 && word_counter < get_skeleton().size());
 	// create a name for the word object
 	ostringstream oss;
 	// trial number is part of name, ensuring a unique name across trials
 	oss << stream_name  << "_" << trial << "_" << word_counter;
 	Symbol wordname = Symbol(oss.str());
-	long duration = durations[word_counter];
+	long duration = get_durations()[word_counter];
 	
 	Speech_word word;
 	word.location = GU::Point(0., 0.);
@@ -128,7 +126,7 @@ void Message::present_word(int trial, int word_counter)
 	word.content = message[word_counter];
 	word.speaker_gender = speaker_gender;
 	word.speaker_id = speaker_id;
-    word.utterance_id = talker_idx * 1000 + callsign_idx * 100 + color_idx * 10 + digit_idx;
+    word.utterance_id = utterance_id;
 	word.pitch = pitches[word_counter];
 //	word.loudness = normal_random_variable(mean_loudness, sd_loudness);
 	word.loudness = loudnesses[word_counter];
@@ -144,8 +142,8 @@ void Message::present_word(int trial, int word_counter)
 
 long Message::get_duration(int word_counter)
 {
-	Assert(word_counter >= 0 && word_counter < durations.size());
-	return durations[word_counter];
+	Assert(word_counter >= 0 && word_counter < get_durations().size());
+	return get_durations()[word_counter];
 }
 
 
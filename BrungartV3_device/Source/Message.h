@@ -25,7 +25,7 @@ typedef std::vector<Words_t> Messages_t;
 struct Message {
 	Message();
     Message(Device_base * device_ptr_, const Symbol& stream_name_, const Symbol& gender_, const Symbol& speaker_id_,
-        int talker_idx_, int callsign_idx_, int color_idx_, int digit_idx_,
+        int talker_idx_, int callsign_idx_, int color_idx_, int digit_idx_, int utterance_id_,
 		const CRM_utterance_stats& utterance_stats,
 		double baseline_loudness,
 //		double mean_loudness_, double sd_loudness_, 
@@ -46,6 +46,7 @@ struct Message {
     int callsign_idx;
     int color_idx;
     int digit_idx;
+    int utterance_id;					// identifies the utterance to the architecture
 	Symbol callsign;
 	Symbol color;
 	Symbol digit;
@@ -58,9 +59,10 @@ struct Message {
 	
 private:
 	Device_base * device_ptr;	// must be initialized at construction
-	// shared by all messages
-	static Words_t skeleton;
-	static std::vector<long> durations;  // assuming all segment durations are equal
+	// shared by all messages; built once on first use and never modified afterwards,
+	// so devices running on separate threads can share them
+	static const Words_t& get_skeleton();
+	static const std::vector<long>& get_durations();  // assuming all segment durations are equal
 	
 };
 
@@ -0,0 +1,185 @@
+/*
+ *  Parameter_race.cpp
+ *  BrungartV3_device
+ *
+ */
+
+#include "Parameter_race.h"
+#include "EPICLib/Assert.h"
+#include "EPICLib/Device_exception.h"
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <algorithm>
+#include <cmath>
+
+using namespace std;
+
+// how many standard errors apart two statistics must be for one candidate to be clearly worse
+const double race_z_c = 2.;
+
+void Parameter_race::load(const string& filename, const vector<string>& condition_labels)
+{
+	ifstream infile(filename.c_str());
+	if(!infile)
+		throw Device_exception(string("Could not open race file: ") + filename);
+	candidates.clear();
+	observations.clear();
+	string line;
+	while(getline(infile, line)) {
+		string::size_type comment_pos = line.find("//");
+		if(comment_pos != string::npos)
+			line.erase(comment_pos);
+		replace(line.begin(), line.end(), '(', ' ');
+		replace(line.begin(), line.end(), ')', ' ');
+		istringstream iss(line);
+		string keyword;
+		if(!(iss >> keyword))
+			continue;
+		if(keyword == "data") {
+			Observation obs;
+			string label;
+			if(!(iss >> obs.n_speakers >> label >> obs.snr >> obs.proportion) || obs.proportion < 0. || obs.proportion > 1.)
+				throw Device_exception(string("Incorrect race data line: ") + line);
+			obs.condition_index = int(find(condition_labels.begin(), condition_labels.end(), label) - condition_labels.begin());
+			if(obs.condition_index == condition_labels.size())
+				throw Device_exception(string("Unknown condition in race data line: ") + line);
+			observations.push_back(obs);
+			}
+		else if(keyword == "candidate") {
+			Candidate candidate;
+			if(!(iss >> candidate.name))
+				throw Device_exception(string("Race candidate needs a name: ") + line);
+			candidates.push_back(candidate);
+			}
+		else {
+			Parameter parameter;
+			parameter.processor = keyword;
+			if(candidates.empty() || !(iss >> parameter.name) || !getline(iss >> ws, parameter.spec))
+				throw Device_exception(string("Incorrect race parameter line: ") + line);
+			parameter.spec.erase(parameter.spec.find_last_not_of(" \t\r") + 1);
+			candidates.back().parameters.push_back(parameter);
+			}
+		}
+	if(candidates.size() < 2 || observations.empty())
+		throw Device_exception(string("Race file must have data and at least two candidates: ") + filename);
+	
+	// the parameters are identified by the processor, the name, and the first word of the specification,
+	// which is the category for those like Content_detection
+	vector<string> keys;
+	for(int ic = 0; ic < candidates.size(); ic++) {
+		vector<string> candidate_keys;
+		for(int ip = 0; ip < candidates[ic].parameters.size(); ip++) {
+			const Parameter& parameter = candidates[ic].parameters[ip];
+			candidate_keys.push_back(parameter.processor + ' ' + parameter.name + ' ' + parameter.spec.substr(0, parameter.spec.find(' ')));
+			}
+		sort(candidate_keys.begin(), candidate_keys.end());
+		if(ic == 0)
+			keys = candidate_keys;
+		else if(candidate_keys != keys)
+			throw Device_exception(string("Race candidate ") + candidates[ic].name + " does not set the same parameters as " 
+				+ candidates[0].name);
+		}
+}
+
+bool Parameter_race::has_observation(int n_speakers, int icondition, double snr) const
+{
+	for(int i = 0; i < observations.size(); i++)
+		if(observations[i].n_speakers == n_speakers && observations[i].condition_index == icondition && observations[i].snr == snr)
+			return true;
+	return false;
+}
+
+int Parameter_race::get_n_surviving() const
+{
+	int n = 0;
+	for(int i = 0; i < candidates.size(); i++)
+		if(candidates[i].surviving)
+			n++;
+	return n;
+}
+
+// cells with no trials are left out
+void Parameter_race::compute_statistic(Candidate& candidate) const
+{
+	const Results_cube& results = candidate.results;
+	double total = 0., variance = 0.;
+	int n_cells = 0;
+	for(int i = 0; i < observations.size(); i++) {
+		const Observation& obs = observations[i];
+		int isnr = 0;
+		while(isnr < results.get_n_snrs() && results.get_snr(isnr) != obs.snr)
+			isnr++;
+		Assert(isnr < results.get_n_snrs());
+		double n = results.get_n_trials(obs.n_speakers, obs.condition_index, isnr);
+		if(n <= 0.)
+			continue;
+		double x = results.get(obs.n_speakers, obs.condition_index, isnr, Results_cube::outcome(0, 0));
+		double p = x / n;
+		double d = p - obs.proportion;
+		// the standard error uses a proportion pulled towards one half, so a few trials that all went 
+		// the same way don't make it zero
+		double ps = (x + 1.) / (n + 2.);
+		double p_variance = ps * (1. - ps) / n;
+		total += d * d - p * (1. - p) / max(n - 1., 1.);
+		variance += 4. * d * d * p_variance + 2. * p_variance * p_variance;
+		n_cells++;
+		}
+	Assert(n_cells > 0);
+	candidate.statistic = total / n_cells;
+	candidate.se = sqrt(variance) / n_cells;
+}
+
+int Parameter_race::eliminate()
+{
+	vector<pair<double, int> > ranks;
+	for(int i = 0; i < candidates.size(); i++) {
+		if(!candidates[i].surviving)
+			continue;
+		compute_statistic(candidates[i]);
+		candidates[i].n_rounds++;
+		ranks.push_back(make_pair(candidates[i].statistic, i));
+		}
+	sort(ranks.begin(), ranks.end());
+	if(ranks.size() < 2)
+		return 0;
+	// the better half is kept, rounding up
+	int n_kept = int(ranks.size() + 1) / 2;
+	const Candidate& worst_kept = candidates[ranks[n_kept - 1].second];
+	double cutoff = worst_kept.statistic + race_z_c * worst_kept.se;
+	int n_dropped = 0;
+	for(int j = n_kept; j < ranks.size(); j++) {
+		Candidate& candidate = candidates[ranks[j].second];
+		if(candidate.statistic - race_z_c * candidate.se > cutoff) {
+			candidate.surviving = false;
+			n_dropped++;
+			}
+		}
+	return n_dropped;
+}
+
+int Parameter_race::get_leader() const
+{
+	int leader = -1;
+	for(int i = 0; i < candidates.size(); i++)
+		if(candidates[i].surviving && (leader < 0 || candidates[i].statistic < candidates[leader].statistic))
+			leader = i;
+	Assert(leader >= 0);
+	return leader;
+}
+
+// survivors before the dropped, each by statistic; the RMSE is from the statistic, taken as zero if negative
+void Parameter_race::write_standings(ostream& os) const
+{
+	vector<pair<pair<bool, double>, int> > order;
+	for(int i = 0; i < candidates.size(); i++)
+		order.push_back(make_pair(make_pair(!candidates[i].surviving, candidates[i].statistic), i));
+	sort(order.begin(), order.end());
+	os << "candidate\tstatus\trounds\tstatistic\tse\trmse" << endl;
+	for(int j = 0; j < order.size(); j++) {
+		const Candidate& candidate = candidates[order[j].second];
+		os << candidate.name << '\t' << (candidate.surviving ? "surviving" : "dropped") << '\t' << candidate.n_rounds << '\t'
+			<< candidate.statistic << '\t' << candidate.se << '\t' << sqrt(max(candidate.statistic, 0.)) << endl;
+		}
+}
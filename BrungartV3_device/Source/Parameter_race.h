@@ -0,0 +1,92 @@
+/*
+ *  Parameter_race.h
+ *  BrungartV3_device
+ *
+ */
+
+#ifndef PARAMETER_RACE_H
+#define PARAMETER_RACE_H
+
+#include "Results_cube.h"
+#include <string>
+#include <vector>
+#include <iosfwd>
+
+/*
+A Parameter_race screens candidate parameter sets by successive halving. The race file has the observed
+proportions of trials with both color and digit correct, one line per cell,
+
+	data <n_speakers> <TD|TS|TT> <snr> <proportion>
+
+and the candidates, each a line "candidate <name>" followed by its parameter specifications in .prs form, e.g.
+
+	(Auditory_perceptual_processor Content_detection Color -18.0 10.0 0.04)
+
+so blocks can be copied from a .prs file. Every candidate must set the same parameters, so that switching
+from one to the next leaves none of the previous one's values behind. Text after // is ignored.
+
+A candidate's statistic is the mean over the data cells of the squared difference between its proportion
+and the observed one, less the binomial variance of its proportion, so it estimates the squared error of
+the candidate's true proportions without the bias from having few trials; its standard error comes from
+the delta method. At each round the survivors are ranked, and those in the worse half that are clearly
+worse than the worst one kept are dropped.
+*/
+class Parameter_race {
+public:
+	struct Parameter {
+		std::string processor;
+		std::string name;
+		std::string spec;
+	};
+	struct Candidate {
+		Candidate() : surviving(true), n_rounds(0), statistic(0.), se(0.) {}
+		std::string name;
+		std::vector<Parameter> parameters;
+		Results_cube results;
+		bool surviving;
+		int n_rounds;		// rounds run
+		double statistic;
+		double se;
+	};
+	struct Observation {
+		int n_speakers;
+		int condition_index;
+		double snr;
+		double proportion;
+	};
+
+	Parameter_race()
+		{}
+	// the condition labels are indexed by condition; throws Device_exception if the file can't be used
+	void load(const std::string& filename, const std::vector<std::string>& condition_labels);
+	bool is_loaded() const
+		{return !candidates.empty();}
+
+	int get_n_candidates() const
+		{return int(candidates.size());}
+	Candidate& get_candidate(int i)
+		{return candidates[i];}
+	const Candidate& get_candidate(int i) const
+		{return candidates[i];}
+	const std::vector<Observation>& get_observations() const
+		{return observations;}
+	// true if there is an observed proportion for the cell
+	bool has_observation(int n_speakers, int icondition, double snr) const;
+	int get_n_surviving() const;
+
+	// update the statistics of the survivors from their results, count the round, and drop the clearly 
+	// worse half; returns the number dropped
+	int eliminate();
+	// the survivor with the lowest statistic
+	int get_leader() const;
+	// a line for each candidate, leader first
+	void write_standings(std::ostream& os) const;
+
+private:
+	std::vector<Candidate> candidates;
+	std::vector<Observation> observations;
+
+	void compute_statistic(Candidate& candidate) const;
+};
+
+#endif
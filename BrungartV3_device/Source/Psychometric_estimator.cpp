@@ -0,0 +1,134 @@
+/*
+ *  Psychometric_estimator.cpp
+ *  BrungartV3_device
+ *
+ */
+
+#include "Psychometric_estimator.h"
+#include "EPICLib/Assert.h"
+
+#include <algorithm>
+#include <cmath>
+
+using namespace std;
+
+// the grid extends this far beyond the candidate SNRs, in steps of this size
+const double threshold_margin_c = 6.;
+const double threshold_step_c = 0.5;
+// slopes are log-spaced between these limits (per dB)
+const double slope_min_c = 0.05;
+const double slope_max_c = 2.0;
+const int n_slopes_c = 15;
+
+Psychometric_estimator::Psychometric_estimator(const vector<double>& stimuli_, double guess_rate_, double lapse_rate_) :
+	stimuli(stimuli_), guess_rate(guess_rate_), lapse_rate(lapse_rate_), n_trials(0)
+{
+	Assert(!stimuli.empty());
+	double lowest = *min_element(stimuli.begin(), stimuli.end()) - threshold_margin_c;
+	double highest = *max_element(stimuli.begin(), stimuli.end()) + threshold_margin_c;
+	for(double t = lowest; t <= highest; t += threshold_step_c)
+		thresholds.push_back(t);
+	for(int i = 0; i < n_slopes_c; i++)
+		slopes.push_back(slope_min_c * pow(slope_max_c / slope_min_c, double(i) / (n_slopes_c - 1)));
+
+	int n_params = int(thresholds.size() * slopes.size());
+	posterior.assign(n_params, 1. / n_params);
+	p_correct.resize(stimuli.size() * n_params);
+	for(int is = 0; is < stimuli.size(); is++)
+		for(int it = 0; it < thresholds.size(); it++)
+			for(int ib = 0; ib < slopes.size(); ib++)
+				p_correct[is * n_params + it * slopes.size() + ib] = guess_rate +
+					(1. - guess_rate - lapse_rate) / (1. + exp(-slopes[ib] * (stimuli[is] - thresholds[it])));
+}
+
+int Psychometric_estimator::choose_stimulus() const
+{
+	int n_params = int(posterior.size());
+	int best = 0;
+	double best_entropy = 0.;
+	vector<double> next(n_params);
+	for(int is = 0; is < stimuli.size(); is++) {
+		const double * pc = &p_correct[is * n_params];
+		double expected_entropy = 0.;
+		// the two possible outcomes, weighted by their predictive probability
+		for(int outcome = 0; outcome < 2; outcome++) {
+			double total = 0.;
+			for(int i = 0; i < n_params; i++) {
+				next[i] = posterior[i] * (outcome ? pc[i] : 1. - pc[i]);
+				total += next[i];
+				}
+			if(total <= 0.)
+				continue;
+			double entropy = 0.;
+			for(int i = 0; i < n_params; i++) {
+				double p = next[i] / total;
+				if(p > 0.)
+					entropy -= p * log(p);
+				}
+			expected_entropy += total * entropy;
+			}
+		if(is == 0 || expected_entropy < best_entropy) {
+			best = is;
+			best_entropy = expected_entropy;
+			}
+		}
+	return best;
+}
+
+void Psychometric_estimator::update(int istimulus, bool correct)
+{
+	Assert(istimulus >= 0 && istimulus < stimuli.size());
+	int n_params = int(posterior.size());
+	const double * pc = &p_correct[istimulus * n_params];
+	double total = 0.;
+	for(int i = 0; i < n_params; i++) {
+		posterior[i] *= correct ? pc[i] : 1. - pc[i];
+		total += posterior[i];
+		}
+	Assert(total > 0.);
+	for(int i = 0; i < n_params; i++)
+		posterior[i] /= total;
+	n_trials++;
+}
+
+void Psychometric_estimator::get_moments(int which, double& mean, double& sd) const
+{
+	double sum = 0., sum_sq = 0.;
+	for(int it = 0; it < thresholds.size(); it++)
+		for(int ib = 0; ib < slopes.size(); ib++) {
+			double x = (which == 0) ? thresholds[it] : slopes[ib];
+			double p = posterior[it * slopes.size() + ib];
+			sum += p * x;
+			sum_sq += p * x * x;
+			}
+	mean = sum;
+	sd = sqrt(max(0., sum_sq - sum * sum));
+}
+
+double Psychometric_estimator::get_threshold_mean() const
+{
+	double mean, sd;
+	get_moments(0, mean, sd);
+	return mean;
+}
+
+double Psychometric_estimator::get_threshold_sd() const
+{
+	double mean, sd;
+	get_moments(0, mean, sd);
+	return sd;
+}
+
+double Psychometric_estimator::get_slope_mean() const
+{
+	double mean, sd;
+	get_moments(1, mean, sd);
+	return mean;
+}
+
+double Psychometric_estimator::get_slope_sd() const
+{
+	double mean, sd;
+	get_moments(1, mean, sd);
+	return sd;
+}
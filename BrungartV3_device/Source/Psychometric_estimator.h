@@ -0,0 +1,55 @@
+/*
+ *  Psychometric_estimator.h
+ *  BrungartV3_device
+ *
+ */
+
+#ifndef PSYCHOMETRIC_ESTIMATOR_H
+#define PSYCHOMETRIC_ESTIMATOR_H
+
+#include <vector>
+
+/*
+A Psychometric_estimator keeps a posterior distribution over the threshold and slope of a logistic
+psychometric function of target SNR,
+
+	p(correct | snr) = guess + (1 - guess - lapse) / (1 + exp(-slope * (snr - threshold)))
+
+on a grid of threshold and slope values, starting from a uniform prior. Following QUEST+,
+choose_stimulus() returns the candidate SNR whose outcome is expected to leave the smallest posterior
+entropy, which puts trials where they best pin down both threshold and slope.
+*/
+class Psychometric_estimator {
+public:
+	Psychometric_estimator(const std::vector<double>& stimuli_, double guess_rate_, double lapse_rate_);
+
+	// the index of the best candidate SNR for the next trial
+	int choose_stimulus() const;
+	// update the posterior with the outcome of a trial at candidate SNR istimulus
+	void update(int istimulus, bool correct);
+
+	int get_n_trials() const
+		{return n_trials;}
+	// posterior means and standard deviations
+	double get_threshold_mean() const;
+	double get_threshold_sd() const;
+	double get_slope_mean() const;
+	double get_slope_sd() const;
+
+private:
+	std::vector<double> stimuli;
+	std::vector<double> thresholds;
+	std::vector<double> slopes;
+	double guess_rate;
+	double lapse_rate;
+	int n_trials;
+	// indexed by threshold * slopes.size() + slope
+	std::vector<double> posterior;
+	// p(correct) for each stimulus and parameter pair, indexed by stimulus * posterior.size() + parameter pair
+	std::vector<double> p_correct;
+
+	// posterior mean and sd of the threshold (which == 0) or slope (which == 1)
+	void get_moments(int which, double& mean, double& sd) const;
+};
+
+#endif
@@ -0,0 +1,78 @@
+/*
+ *  Results_cache.cpp
+ *  BrungartV3_device
+ *
+ */
+
+#include "Results_cache.h"
+
+#include <sstream>
+#include <iomanip>
+#include <limits>
+
+using namespace std;
+
+const uint64_t hash_prime_c = 1099511628211ULL;
+
+uint64_t Results_cache::hash(const string& s, uint64_t h)
+{
+	for(int i = 0; i < s.size(); i++) {
+		h ^= static_cast<unsigned char>(s[i]);
+		h *= hash_prime_c;
+		}
+	return h;
+}
+
+// a line that can't be read, such as one cut short when a process was killed, is skipped, and ended so that
+// the next entry starts a line of its own
+bool Results_cache::open(const string& filename)
+{
+	entries.clear();
+	ifstream infile(filename.c_str());
+	string line;
+	while(getline(infile, line)) {
+		istringstream iss(line);
+		uint64_t key;
+		int n;
+		if(!(iss >> hex >> key >> dec >> n) || n < 0)
+			continue;
+		vector<double> values(n);
+		for(int i = 0; i < n && iss; i++)
+			iss >> values[i];
+		if(iss)
+			entries[key] = values;
+		}
+	infile.clear();
+	char last = '\n';
+	if(infile.seekg(-1, ios::end))
+		infile.get(last);
+	file.open(filename.c_str(), ios::app);
+	if(file.is_open() && last != '\n')
+		file << '\n' << flush;
+	return file.is_open();
+}
+
+bool Results_cache::lookup(uint64_t key, vector<double>& values) const
+{
+	map<uint64_t, vector<double> >::const_iterator it = entries.find(key);
+	if(it == entries.end())
+		return false;
+	values = it->second;
+	return true;
+}
+
+// the line is built first and written in one piece
+bool Results_cache::store(uint64_t key, const vector<double>& values)
+{
+	ostringstream oss;
+	oss << hex << setw(16) << setfill('0') << key << dec << ' ' << values.size();
+	oss << setprecision(numeric_limits<double>::digits10 + 2);
+	for(int i = 0; i < values.size(); i++)
+		oss << ' ' << values[i];
+	oss << '\n';
+	string line = oss.str();
+	file.write(line.data(), line.size());
+	file.flush();
+	entries[key] = values;
+	return bool(file);
+}
@@ -0,0 +1,50 @@
+/*
+ *  Results_cache.h
+ *  BrungartV3_device
+ *
+ */
+
+#ifndef RESULTS_CACHE_H
+#define RESULTS_CACHE_H
+
+#include <string>
+#include <vector>
+#include <map>
+#include <fstream>
+#include <cstdint>
+
+/*
+A Results_cache is a local store of completed results, kept in a flat text file with one line per entry:
+a 64-bit key in hex, the number of values, and the values. The whole file is read into an in-memory index
+when it is opened, and new entries are appended and flushed one line at a time, so an interrupted run
+loses nothing it has finished and several processes can share a file. If a key appears more than once,
+the last entry wins.
+
+Keys are made by hashing everything that determines the results with FNV-1a; chaining calls to hash()
+combines several inputs into one key.
+*/
+class Results_cache {
+public:
+	static const uint64_t hash_basis_c = 14695981039346656037ULL;
+	static uint64_t hash(const std::string& s, uint64_t h = hash_basis_c);
+
+	Results_cache()
+		{}
+	// read the existing entries, if any, and get ready to append; returns false if the file can't be used
+	bool open(const std::string& filename);
+	bool is_open() const
+		{return file.is_open();}
+	int get_n_entries() const
+		{return int(entries.size());}
+
+	// returns false if there is no entry for the key
+	bool lookup(uint64_t key, std::vector<double>& values) const;
+	// returns false if the entry could not be written
+	bool store(uint64_t key, const std::vector<double>& values);
+
+private:
+	std::map<uint64_t, std::vector<double> > entries;
+	std::ofstream file;
+};
+
+#endif
@@ -0,0 +1,92 @@
+/*
+ *  Results_cube.cpp
+ *  BrungartV3_device
+ *
+ */
+
+#include "Results_cube.h"
+#include "EPICLib/Assert.h"
+
+#include <iostream>
+#include <algorithm>
+#include <cstring>
+#include <cstdint>
+
+using namespace std;
+
+const char binary_magic_c[8] = {'B', 'R', 'C', 'U', 'B', 'E', '1', '\n'};
+
+void Results_cube::reset(const vector<double>& snrs_)
+{
+	snrs = snrs_;
+	counts.assign(n_speaker_counts_c * n_conditions_c * snrs.size() * n_outcomes_c, 0.);
+}
+
+void Results_cube::clear()
+{
+	fill(counts.begin(), counts.end(), 0.);
+}
+
+int Results_cube::index(int n_speakers, int icondition, int isnr, int ioutcome) const
+{
+	int ispeakers = n_speakers - min_speakers_c;
+	Assert(ispeakers >= 0 && ispeakers < n_speaker_counts_c);
+	Assert(icondition >= 0 && icondition < n_conditions_c);
+	Assert(isnr >= 0 && isnr < snrs.size());
+	Assert(ioutcome >= 0 && ioutcome < n_outcomes_c);
+	return ((ispeakers * n_conditions_c + icondition) * int(snrs.size()) + isnr) * n_outcomes_c + ioutcome;
+}
+
+void Results_cube::get_table(int n_speakers, int icondition, int isnr, double table[3][3]) const
+{
+	for(int icr = 0; icr < 3; icr++)
+		for(int idr = 0; idr < 3; idr++)
+			table[icr][idr] = get(n_speakers, icondition, isnr, outcome(icr, idr));
+}
+
+double Results_cube::get_n_trials(int n_speakers, int icondition, int isnr) const
+{
+	double n = 0.;
+	for(int i = 0; i < n_outcomes_c; i++)
+		n += get(n_speakers, icondition, isnr, i);
+	return n;
+}
+
+bool Results_cube::accumulate(const Results_cube& other)
+{
+	if(other.snrs != snrs)
+		return false;
+	Assert(other.counts.size() == counts.size());
+	for(int i = 0; i < counts.size(); i++)
+		counts[i] += other.counts[i];
+	return true;
+}
+
+// the values are written in the native byte order
+void Results_cube::write_binary(ostream& os) const
+{
+	os.write(binary_magic_c, sizeof(binary_magic_c));
+	int32_t dims[4] = {n_speaker_counts_c, n_conditions_c, int32_t(snrs.size()), n_outcomes_c};
+	os.write(reinterpret_cast<const char *>(dims), sizeof(dims));
+	os.write(reinterpret_cast<const char *>(snrs.data()), snrs.size() * sizeof(double));
+	os.write(reinterpret_cast<const char *>(counts.data()), counts.size() * sizeof(double));
+}
+
+bool Results_cube::read_binary(istream& is)
+{
+	char magic[sizeof(binary_magic_c)];
+	if(!is.read(magic, sizeof(magic)) || memcmp(magic, binary_magic_c, sizeof(magic)))
+		return false;
+	int32_t dims[4];
+	if(!is.read(reinterpret_cast<char *>(dims), sizeof(dims)))
+		return false;
+	if(dims[0] != n_speaker_counts_c || dims[1] != n_conditions_c || dims[2] < 0 || dims[3] != n_outcomes_c)
+		return false;
+	vector<double> new_snrs(dims[2]);
+	if(!is.read(reinterpret_cast<char *>(new_snrs.data()), new_snrs.size() * sizeof(double)))
+		return false;
+	reset(new_snrs);
+	if(!is.read(reinterpret_cast<char *>(counts.data()), counts.size() * sizeof(double)))
+		return false;
+	return true;
+}
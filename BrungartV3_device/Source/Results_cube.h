@@ -0,0 +1,72 @@
+/*
+ *  Results_cube.h
+ *  BrungartV3_device
+ *
+ */
+
+#ifndef RESULTS_CUBE_H
+#define RESULTS_CUBE_H
+
+#include <vector>
+#include <iosfwd>
+
+/*
+A Results_cube holds the outcome counts for every cell of the full factorial design,
+indexed by (number of speakers, masking condition, target SNR, outcome), for the whole run.
+The outcomes are the nine cells of the color (rows) by digit (columns) Target/Masker/Neither
+contingency table, so outcome = color_category * 3 + digit_category, followed by the trials with
+no response before the timeout; every other statistic is a marginal of these. Counts are doubles so that the surrogate's expected counts fit too;
+whole counts are exact up to 2^53.
+
+Cubes with the same shape, e.g. from sharded or repeated runs, are combined by adding them.
+*/
+class Results_cube {
+public:
+	static const int n_speaker_counts_c = 3;	// 2, 3, or 4 speakers
+	static const int min_speakers_c = 2;
+	static const int n_conditions_c = 3;		// TD, TS, TT
+	static const int n_outcomes_c = 10;
+	static const int timeout_outcome_c = 9;
+
+	Results_cube()
+		{}
+	// set the SNR axis and clear all counts
+	void reset(const std::vector<double>& snrs_);
+	void clear();
+
+	int get_n_snrs() const
+		{return int(snrs.size());}
+	double get_snr(int isnr) const
+		{return snrs[isnr];}
+
+	// the outcome category from the color and digit categories, each 0 for target, 1 for masker, 2 for neither
+	static int outcome(int color_category, int digit_category)
+		{return color_category * 3 + digit_category;}
+
+	void add(int n_speakers, int icondition, int isnr, int ioutcome, double count = 1.)
+		{counts[index(n_speakers, icondition, isnr, ioutcome)] += count;}
+	double get(int n_speakers, int icondition, int isnr, int ioutcome) const
+		{return counts[index(n_speakers, icondition, isnr, ioutcome)];}
+	// fill table with the color (rows) by digit (columns) contingency table for a cell
+	void get_table(int n_speakers, int icondition, int isnr, double table[3][3]) const;
+	// the total number of trials in a cell, including those that timed out
+	double get_n_trials(int n_speakers, int icondition, int isnr) const;
+	double get_n_timeouts(int n_speakers, int icondition, int isnr) const
+		{return get(n_speakers, icondition, isnr, timeout_outcome_c);}
+
+	// add the counts from a cube of the same shape; returns false if the shapes differ
+	bool accumulate(const Results_cube& other);
+
+	// a compact binary form: a magic string, the dimensions, the SNR values, and the counts
+	void write_binary(std::ostream& os) const;
+	// returns false if the stream does not hold a cube
+	bool read_binary(std::istream& is);
+
+private:
+	std::vector<double> snrs;
+	std::vector<double> counts;
+
+	int index(int n_speakers, int icondition, int isnr, int ioutcome) const;
+};
+
+#endif
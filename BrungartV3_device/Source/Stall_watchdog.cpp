@@ -0,0 +1,70 @@
+/*
+ *  Stall_watchdog.cpp
+ *  BrungartV3_device
+ *
+ */
+
+#include "Stall_watchdog.h"
+
+#include <iostream>
+#include <cstdlib>
+
+using namespace std;
+
+void Stall_watchdog::start(double stall_seconds_, bool exit_if_stuck_, const string& where_)
+{
+	stop();
+	stall_seconds = stall_seconds_;
+	exit_if_stuck = exit_if_stuck_;
+	stalled = false;
+	stopping = false;
+	last_progress_time = chrono::steady_clock::now();
+	where = where_;
+	watcher = thread(&Stall_watchdog::watch, this);
+}
+
+void Stall_watchdog::stop()
+{
+	if(!watcher.joinable())
+		return;
+	{
+		lock_guard<mutex> lock(progress_mutex);
+		stopping = true;
+	}
+	stop_condition.notify_one();
+	watcher.join();
+}
+
+void Stall_watchdog::note_progress(const string& where_)
+{
+	lock_guard<mutex> lock(progress_mutex);
+	last_progress_time = chrono::steady_clock::now();
+	where = where_;
+}
+
+// wake up when the stall time since the last progress would be up, and check whether there has been more since;
+// after a stall, either leave the stopping to the owner, or wait another stall time for it before ending the process
+void Stall_watchdog::watch()
+{
+	chrono::steady_clock::duration stall_time = chrono::duration_cast<chrono::steady_clock::duration>(
+		chrono::duration<double>(stall_seconds));
+	unique_lock<mutex> lock(progress_mutex);
+	while(!stopping) {
+		chrono::steady_clock::time_point deadline = last_progress_time + stall_time;
+		if(chrono::steady_clock::now() < deadline) {
+			stop_condition.wait_until(lock, deadline);
+			continue;
+			}
+		cerr << "Stalled: no progress in " << stall_seconds << " seconds; last progress: " << where << endl;
+		stalled = true;
+		if(!exit_if_stuck)
+			return;
+		deadline = chrono::steady_clock::now() + stall_time;
+		while(!stopping && chrono::steady_clock::now() < deadline)
+			stop_condition.wait_until(lock, deadline);
+		if(!stopping) {
+			cerr << "Stalled run did not stop within another " << stall_seconds << " seconds; ending the process" << endl;
+			_Exit(EXIT_FAILURE);
+			}
+		}
+}
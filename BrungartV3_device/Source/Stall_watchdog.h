@@ -0,0 +1,62 @@
+/*
+ *  Stall_watchdog.h
+ *  BrungartV3_device
+ *
+ */
+
+#ifndef STALL_WATCHDOG_H
+#define STALL_WATCHDOG_H
+
+#include <string>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+#include <atomic>
+
+/*
+A Stall_watchdog watches for progress in wall-clock time from a thread of its own. If nothing reports progress
+for the stall time, it writes a diagnostic, including the last description of where the run was, to the standard
+error stream and marks the run as stalled; it can't safely do anything more itself, because the thread that has
+stalled may be anywhere. The owner checks has_stalled on its own thread and stops, writing what it has. By default
+that is all, so a run paused in a GUI is stopped at its next event rather than ended with its host. If the watchdog
+is started with exit_if_stuck, and the owner hasn't stopped it within a further stall time, the process is ended
+with a failure status, since its thread is then stuck where the owner never gets control; results written before
+then are left in place. Only an unattended run, with no GUI to pause it, should ask for that.
+
+A watchdog must be started after any fork, since the thread is not copied into the child.
+*/
+class Stall_watchdog {
+public:
+	Stall_watchdog() : stall_seconds(0.), exit_if_stuck(false), stalled(false), stopping(false)
+		{}
+	~Stall_watchdog()
+		{stop();}
+	void start(double stall_seconds_, bool exit_if_stuck_, const std::string& where_);
+	void stop();
+	bool is_running() const
+		{return watcher.joinable();}
+	// reset the stall time, with a new description of where the run is
+	void note_progress(const std::string& where_);
+	// true once a stall has been found, until the watchdog is started again
+	bool has_stalled() const
+		{return stalled;}
+
+private:
+	double stall_seconds;
+	bool exit_if_stuck;
+	std::atomic<bool> stalled;
+	std::thread watcher;
+	std::mutex progress_mutex;	// for the members below
+	std::condition_variable stop_condition;
+	bool stopping;
+	std::chrono::steady_clock::time_point last_progress_time;
+	std::string where;
+
+	void watch();
+
+	Stall_watchdog(const Stall_watchdog&);
+	Stall_watchdog& operator= (const Stall_watchdog&);
+};
+
+#endif
@@ -0,0 +1,252 @@
+/*
+ *  Surrogate_evaluator.cpp
+ *  BrungartV3_device
+ *
+ */
+
+#include "Surrogate_evaluator.h"
+#include "EPICLib/Assert.h"
+#include "EPICLib/Device_exception.h"
+
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <algorithm>
+#include <cmath>
+
+using namespace std;
+
+// the message segments holding the callsign, color, and digit words (6-beat analysis)
+const int word_segments_c[3] = {1, 3, 4};
+
+Surrogate_parameters::Surrogate_parameters() :
+	loudness_weight(1.0), pitch_weight(0.0), pitch_difference_cap(0.0),
+	stream_loudness_weight(1.0), stream_pitch_weight(0.0), stream_theta(0.0)
+{
+}
+
+// scan the file for parameter specifications like
+// (Auditory_perceptual_processor Content_detection Color -18.0 10.0 0.04)
+// ignoring anything commented out; a Nil Content_detection supplies the default for all categories
+void Surrogate_parameters::load_from_prs_file(const string& prs_filename)
+{
+	ifstream infile(prs_filename.c_str());
+	if(!infile)
+		throw Device_exception(string("Could not open .prs file for surrogate parameters: ") + prs_filename);
+
+	bool callsign_found = false, color_found = false, digit_found = false;
+	Detection_spec default_spec;
+	string line;
+	while(getline(infile, line)) {
+		string::size_type comment_pos = line.find("//");
+		if(comment_pos != string::npos)
+			line.erase(comment_pos);
+		replace(line.begin(), line.end(), '(', ' ');
+		replace(line.begin(), line.end(), ')', ' ');
+		istringstream iss(line);
+		string processor, param_name;
+		if(!(iss >> processor >> param_name) || processor != "Auditory_perceptual_processor")
+			continue;
+		if(param_name == "Content_detection") {
+			string category;
+			Detection_spec spec;
+			if(!(iss >> category >> spec.mean >> spec.sd >> spec.lapse) || spec.sd <= 0.)
+				throw Device_exception(string("Incorrect Content_detection specification: ") + line);
+			if(category == "Callsign") {
+				callsign = spec;
+				callsign_found = true;
+				}
+			else if(category == "Color") {
+				color = spec;
+				color_found = true;
+				}
+			else if(category == "Digit") {
+				digit = spec;
+				digit_found = true;
+				}
+			else if(category == "Nil")
+				default_spec = spec;
+			continue;
+			}
+		string spec;
+		double value;
+		if(!(iss >> spec >> value))
+			continue;
+		if(param_name == "Effective_snr_loudness_weight")
+			loudness_weight = value;
+		else if(param_name == "Effective_snr_pitch_weight")
+			pitch_weight = value;
+		else if(param_name == "Pitch_difference_cap")
+			pitch_difference_cap = value;
+		else if(param_name == "Stream_loudness_weight")
+			stream_loudness_weight = value;
+		else if(param_name == "Stream_pitch_weight")
+			stream_pitch_weight = value;
+		else if(param_name == "Stream_theta")
+			stream_theta = value;
+		}
+
+	if(!callsign_found)
+		callsign = default_spec;
+	if(!color_found)
+		color = default_spec;
+	if(!digit_found)
+		digit = default_spec;
+}
+
+Surrogate_evaluator::Surrogate_evaluator(const Surrogate_parameters& parameters_, int n_colors_, int n_digits_) :
+	parameters(parameters_), n_colors(n_colors_), n_digits(n_digits_), n_trials(0)
+{
+}
+
+void Surrogate_evaluator::add_trial(const vector<Message>& messages, int n_speakers)
+{
+	Assert(n_speakers <= n_streams_max_c && n_speakers <= messages.size());
+	n_streams.push_back(n_speakers);
+	for(int iw = 0; iw < n_words_c; iw++) {
+		int seg = word_segments_c[iw];
+		for(int im = 0; im < n_streams_max_c; im++) {
+			// the effective SNR of a word is taken against its strongest competitor
+			double snr = 0.;
+			if(im < n_speakers) {
+				bool first = true;
+				for(int ik = 0; ik < n_speakers; ik++) {
+					if(ik == im)
+						continue;
+					double pitch_difference = fabs(messages[im].pitches[seg] - messages[ik].pitches[seg]);
+					double x = parameters.loudness_weight * (messages[im].loudnesses[seg] - messages[ik].loudnesses[seg])
+						+ parameters.pitch_weight * min(pitch_difference, parameters.pitch_difference_cap);
+					if(first || x < snr)
+						snr = x;
+					first = false;
+					}
+				}
+			snrs[iw][im].push_back(snr);
+			}
+		}
+	compute_stream_probabilities(messages, n_speakers, 1);
+	compute_stream_probabilities(messages, n_speakers, 2);
+	n_trials++;
+}
+
+// the target stream is anchored on the voice of the target callsign; each stream's word competes to join it
+// by its voice distance from that anchor, softly if Stream_theta is positive, otherwise the nearest voice wins
+void Surrogate_evaluator::compute_stream_probabilities(const vector<Message>& messages, int n_speakers, int iw)
+{
+	int anchor_seg = word_segments_c[0];
+	int seg = word_segments_c[iw];
+	double distances[n_streams_max_c];
+	double min_distance = 0.;
+	for(int im = 0; im < n_speakers; im++) {
+		distances[im] = parameters.stream_loudness_weight * fabs(messages[im].loudnesses[seg] - messages[0].loudnesses[anchor_seg])
+			+ parameters.stream_pitch_weight * fabs(messages[im].pitches[seg] - messages[0].pitches[anchor_seg]);
+		if(im == 0 || distances[im] < min_distance)
+			min_distance = distances[im];
+		}
+	double weights[n_streams_max_c];
+	double total = 0.;
+	for(int im = 0; im < n_speakers; im++) {
+		if(parameters.stream_theta > 0.)
+			weights[im] = exp((min_distance - distances[im]) / parameters.stream_theta);
+		else
+			weights[im] = (distances[im] == min_distance) ? 1. : 0.;
+		total += weights[im];
+		}
+	for(int im = 0; im < n_streams_max_c; im++)
+		stream_probs[iw][im].push_back(im < n_speakers ? weights[im] / total : 0.);
+}
+
+// the detection kernel: a straight loop over contiguous arrays; it vectorizes only where the compiler
+// has a vector erfc to call, otherwise it is one library erfc call per element
+void Surrogate_evaluator::compute_detection_probabilities(int iw, const Detection_spec& spec)
+{
+	const double scale = 1. / (spec.sd * sqrt(2.));
+	const double gain = 0.5 * (1. - spec.lapse);
+	for(int im = 0; im < n_streams_max_c; im++) {
+		const double * x = snrs[iw][im].data();
+		probs[iw][im].resize(n_trials);
+		double * p = probs[iw][im].data();
+		for(int i = 0; i < n_trials; i++)
+			p[i] = gain * erfc((spec.mean - x[i]) * scale);
+		}
+}
+
+// response probabilities for target/masker/neither, both when the target stream is known and when it is not
+void Surrogate_evaluator::accumulate_response_probabilities(int iw, int n_choices, int itrial,
+	double known[3], double unknown[3]) const
+{
+	int n = n_streams[itrial];
+	double d[n_streams_max_c];
+	for(int im = 0; im < n; im++)
+		d[im] = probs[iw][im][itrial];
+	// a guess is uniform over all the response alternatives; the words in the messages are all different
+	double guess[3] = {1. / n_choices, double(n - 1) / n_choices, double(n_choices - n) / n_choices};
+
+	// target callsign heard: if the target word stays in the target stream, report it if heard,
+	// otherwise a heard masker word, otherwise guess; if a masker's word captured the stream,
+	// report that word if heard, otherwise guess
+	double p_no_masker = 1.;
+	for(int im = 1; im < n; im++)
+		p_no_masker *= 1. - d[im];
+	double p_guess = (1. - d[0]) * p_no_masker;
+	double p_kept = stream_probs[iw][0][itrial];
+	known[0] = p_kept * (d[0] + p_guess * guess[0]);
+	known[1] = p_kept * ((1. - d[0]) * (1. - p_no_masker) + p_guess * guess[1]);
+	known[2] = p_kept * p_guess * guess[2];
+	for(int im = 1; im < n; im++) {
+		double p_captured = stream_probs[iw][im][itrial];
+		known[0] += p_captured * (1. - d[im]) * guess[0];
+		known[1] += p_captured * (d[im] + (1. - d[im]) * guess[1]);
+		known[2] += p_captured * (1. - d[im]) * guess[2];
+		}
+
+	// target unknown: choose at random among the heard words, so enumerate which ones were heard
+	unknown[0] = unknown[1] = unknown[2] = 0.;
+	for(int subset = 0; subset < (1 << n); subset++) {
+		double p = 1.;
+		int n_heard = 0;
+		for(int im = 0; im < n; im++) {
+			if(subset & (1 << im)) {
+				p *= d[im];
+				n_heard++;
+				}
+			else
+				p *= 1. - d[im];
+			}
+		if(n_heard == 0) {
+			for(int i = 0; i < 3; i++)
+				unknown[i] += p * guess[i];
+			continue;
+			}
+		bool target_heard = subset & 1;
+		unknown[0] += p * (target_heard ? 1. : 0.) / n_heard;
+		unknown[1] += p * (target_heard ? n_heard - 1 : n_heard) / n_heard;
+		}
+}
+
+void Surrogate_evaluator::evaluate(double table[3][3])
+{
+	compute_detection_probabilities(0, parameters.callsign);
+	compute_detection_probabilities(1, parameters.color);
+	compute_detection_probabilities(2, parameters.digit);
+
+	for(int i = 0; i < n_trials; i++) {
+		double color_known[3], color_unknown[3], digit_known[3], digit_unknown[3];
+		accumulate_response_probabilities(1, n_colors, i, color_known, color_unknown);
+		accumulate_response_probabilities(2, n_digits, i, digit_known, digit_unknown);
+		// the target stream is established if the target callsign was heard
+		double p_known = probs[0][0][i];
+		for(int icr = 0; icr < 3; icr++)
+			for(int idr = 0; idr < 3; idr++)
+				table[icr][idr] += p_known * color_known[icr] * digit_known[idr]
+					+ (1. - p_known) * color_unknown[icr] * digit_unknown[idr];
+		}
+
+	n_trials = 0;
+	n_streams.clear();
+	for(int iw = 0; iw < n_words_c; iw++)
+		for(int im = 0; im < n_streams_max_c; im++) {
+			snrs[iw][im].clear();
+			stream_probs[iw][im].clear();
+			}
+}
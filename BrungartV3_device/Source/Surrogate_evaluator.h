@@ -0,0 +1,88 @@
+/*
+ *  Surrogate_evaluator.h
+ *  BrungartV3_device
+ *
+ *  Closed-form approximation of the model's color/digit response proportions,
+ *  used to screen parameter sets without running the cognitive architecture.
+ *
+ */
+
+#ifndef SURROGATE_EVALUATOR_H
+#define SURROGATE_EVALUATOR_H
+
+#include "Message.h"
+#include <string>
+#include <vector>
+
+// detection function for a word category: probability that a word with a given effective SNR
+// is heard is (1 - lapse) * Phi((snr - mean) / sd), as in the .prs Content_detection specifications
+struct Detection_spec {
+	Detection_spec() : mean(-20.), sd(10.), lapse(0.)
+		{}
+	double mean;
+	double sd;
+	double lapse;
+};
+
+// the auditory parameters that determine most of a fit, read from the Define Parameters block of a .prs file
+struct Surrogate_parameters {
+	Surrogate_parameters();
+	// throws Device_exception if the file can't be read
+	void load_from_prs_file(const std::string& prs_filename);
+
+	double loudness_weight;
+	double pitch_weight;
+	double pitch_difference_cap;
+	// voice distance for stream assignment, and the softness of the assignment; 0 means the nearest voice always wins
+	double stream_loudness_weight;
+	double stream_pitch_weight;
+	double stream_theta;
+	Detection_spec callsign;
+	Detection_spec color;
+	Detection_spec digit;
+};
+
+/*
+Surrogate_evaluator accumulates a batch of trials, each described by its set of messages, and then evaluates
+the whole batch at once. For each callsign, color, and digit word of each message, the effective SNR against
+the strongest competing word is the weighted loudness difference plus the weighted (capped) pitch difference;
+detection probabilities follow from the Detection_specs. Hearing the target callsign establishes the target
+stream, but each later word can still be captured by a masker whose voice is as close to the target callsign's
+voice as the target's own word is: a word joins the target stream with probability proportional to
+exp(-distance / Stream_theta), the distance being the Stream-weighted loudness plus pitch difference, so same-talker
+(TT) maskers are often confused. The response rule is a simplified use-what-you-heard strategy: if the target
+callsign is heard and the stream holds the target word, the target word is reported if heard, otherwise a heard
+masker word, otherwise a guess; if a masker captured the stream, its word is reported if heard, otherwise a guess;
+if the target callsign is not heard, one of the heard words is chosen at random, otherwise a guess.
+Color and digit choices are treated as independent given whether the target callsign was heard.
+The result is the expected color (rows) by digit (columns) Target/Masker/Neither contingency table.
+*/
+class Surrogate_evaluator {
+public:
+	Surrogate_evaluator(const Surrogate_parameters& parameters_, int n_colors_, int n_digits_);
+
+	// add a trial; messages[0] is the target, the next n_speakers - 1 are maskers
+	void add_trial(const std::vector<Message>& messages, int n_speakers);
+	// evaluate the batch, add the expected counts to the table, and empty the batch
+	void evaluate(double table[3][3]);
+
+private:
+	static const int n_words_c = 3;		// callsign, color, digit
+	static const int n_streams_max_c = 4;
+	Surrogate_parameters parameters;
+	int n_colors;
+	int n_digits;
+	int n_trials;
+	// structure-of-arrays batch storage, one array per (word, stream), so the kernels run over contiguous data
+	std::vector<int> n_streams;
+	std::vector<double> snrs[n_words_c][n_streams_max_c];
+	std::vector<double> probs[n_words_c][n_streams_max_c];
+	// probability that the word from each stream joins the target stream, given the target callsign was heard
+	std::vector<double> stream_probs[n_words_c][n_streams_max_c];
+
+	void compute_detection_probabilities(int word, const Detection_spec& spec);
+	void compute_stream_probabilities(const std::vector<Message>& messages, int n_speakers, int word);
+	void accumulate_response_probabilities(int word, int n_choices, int itrial, double known[3], double unknown[3]) const;
+};
+
+#endif
@@ -0,0 +1,95 @@
+/*
+ *  Utterance_pair_index.cpp
+ *  BrungartV3_device
+ *
+ */
+
+#include "Utterance_pair_index.h"
+#include "Results_cube.h"
+#include "EPICLib/Assert.h"
+
+#include <algorithm>
+#include <cmath>
+
+using namespace std;
+
+// the color and digit segments (6-beat analysis)
+const int content_segments_c[2] = {3, 4};
+
+void Utterance_pair_index::load(const Surrogate_parameters& parameters_, const CRM_corpus& corpus_)
+{
+	parameters = parameters_;
+	corpus = &corpus_;
+	int n_utterances = corpus->get_n_utterances();
+	loudnesses.resize(n_utterances * 2);
+	pitches.resize(n_utterances * 2);
+	for(int it = 0; it < corpus->get_n_talkers(); it++)
+		for(int ic = 0; ic < corpus->get_n_callsigns(); ic++)
+			for(int ik = 0; ik < corpus->get_n_colors(); ik++)
+				for(int id = 0; id < corpus->get_n_digits(); id++) {
+					int i = corpus->get_index(it, ic, ik, id);
+					const CRM_utterance_stats& stats = corpus->get(it, ic, ik, id);
+					for(int is = 0; is < 2; is++) {
+						loudnesses[i * 2 + is] = stats.loudnesses[content_segments_c[is]];
+						pitches[i * 2 + is] = stats.pitches[content_segments_c[is]];
+						}
+					}
+	bin_edges.assign(Results_cube::n_speaker_counts_c * Results_cube::n_conditions_c, vector<Rank_t>());
+	n_bins = 0;
+}
+
+double Utterance_pair_index::get_difficulty(const int talkers[], const int callsigns[], const int colors[], const int digits[], 
+	int n_speakers) const
+{
+	Assert(corpus && n_speakers >= 2);
+	int target = corpus->get_index(talkers[0], callsigns[0], colors[0], digits[0]);
+	double total = 0.;
+	for(int is = 0; is < 2; is++) {
+		double lowest = 0.;
+		for(int im = 1; im < n_speakers; im++) {
+			int masker = corpus->get_index(talkers[im], callsigns[im], colors[im], digits[im]);
+			double pitch_difference = fabs(pitches[target * 2 + is] - pitches[masker * 2 + is]);
+			double x = parameters.loudness_weight * (loudnesses[target * 2 + is] - loudnesses[masker * 2 + is])
+				+ parameters.pitch_weight * min(pitch_difference, parameters.pitch_difference_cap);
+			if(im == 1 || x < lowest)
+				lowest = x;
+			}
+		total += lowest;
+		}
+	return total / 2.;
+}
+
+void Utterance_pair_index::set_bins(int n_speakers, int icondition, const vector<double>& sample_difficulties, int n_bins_, 
+	mt19937& engine)
+{
+	int n_sample = int(sample_difficulties.size());
+	Assert(n_bins_ > 0 && n_sample >= n_bins_);
+	Assert(n_bins == 0 || n_bins == n_bins_);
+	n_bins = n_bins_;
+	uniform_real_distribution<double> tie_breaker(0., 1.);
+	vector<Rank_t> ranked;
+	for(int i = 0; i < n_sample; i++)
+		ranked.push_back(Rank_t(sample_difficulties[i], tie_breaker(engine)));
+	sort(ranked.begin(), ranked.end());
+	// each edge is the first of the sample in the bin above it
+	vector<Rank_t>& edges = bin_edges[get_cell_index(n_speakers, icondition)];
+	edges.clear();
+	for(int ib = 1; ib < n_bins; ib++)
+		edges.push_back(ranked[ib * n_sample / n_bins]);
+}
+
+int Utterance_pair_index::get_bin(int n_speakers, int icondition, double difficulty, mt19937& engine) const
+{
+	const vector<Rank_t>& edges = bin_edges[get_cell_index(n_speakers, icondition)];
+	Assert(n_bins > 0 && edges.size() == n_bins - 1);
+	Rank_t rank(difficulty, uniform_real_distribution<double>(0., 1.)(engine));
+	return int(upper_bound(edges.begin(), edges.end(), rank) - edges.begin());
+}
+
+int Utterance_pair_index::get_cell_index(int n_speakers, int icondition)
+{
+	int ispeakers = n_speakers - Results_cube::min_speakers_c;
+	Assert(ispeakers >= 0 && ispeakers < Results_cube::n_speaker_counts_c);
+	Assert(icondition >= 0 && icondition < Results_cube::n_conditions_c);
+	return ispeakers * Results_cube::n_conditions_c + icondition;
+}
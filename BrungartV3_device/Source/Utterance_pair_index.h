@@ -0,0 +1,62 @@
+/*
+ *  Utterance_pair_index.h
+ *  BrungartV3_device
+ *
+ */
+
+#ifndef UTTERANCE_PAIR_INDEX_H
+#define UTTERANCE_PAIR_INDEX_H
+
+#include "CRM_corpus.h"
+#include "Surrogate_evaluator.h"
+#include <vector>
+#include <random>
+
+/*
+An Utterance_pair_index rates how hard a trial's stimulus is from the acoustics of its utterances alone, and
+divides the possible stimuli for each number of speakers and masking condition into difficulty bins.
+The difficulty is the target's effective SNR against its strongest masker, computed as in Surrogate_evaluator,
+averaged over the color and digit segments, and without the SNR of the cell, which is the same for every trial;
+lower is harder. The color and digit segments of every utterance in the corpus are kept in flat arrays, so a rating
+takes only a few lookups.
+
+The bin edges for a number of speakers and condition are the quantiles of the difficulties of a sample of stimuli
+drawn the usual way, so each bin holds an equal share of the stimuli that would be presented without stratification,
+up to the sampling error of the edges. Each difficulty is paired with a uniform random tie-breaker, so that bins
+stay equal even where many stimuli have the same difficulty. A stimulus drawn the usual way is then placed in its
+bin by its difficulty and a fresh tie-breaker.
+*/
+class Utterance_pair_index {
+public:
+	Utterance_pair_index() : corpus(0), n_bins(0)
+		{}
+	// copy the color and digit segments from the corpus, which must outlive this index
+	void load(const Surrogate_parameters& parameters_, const CRM_corpus& corpus_);
+
+	// the utterance indices are given for each message, target first
+	double get_difficulty(const int talkers[], const int callsigns[], const int colors[], const int digits[], int n_speakers) const;
+
+	// set the bin edges for a number of speakers and condition from the difficulties of a sample of stimuli;
+	// the engine supplies the tie-breakers
+	void set_bins(int n_speakers, int icondition, const std::vector<double>& sample_difficulties, int n_bins_, 
+		std::mt19937& engine);
+	int get_n_bins() const
+		{return n_bins;}
+	// the bin of a stimulus with this difficulty, 0 for the hardest
+	int get_bin(int n_speakers, int icondition, double difficulty, std::mt19937& engine) const;
+
+private:
+	Surrogate_parameters parameters;
+	const CRM_corpus * corpus;
+	// indexed by utterance * 2 + 0 for the color segment, 1 for the digit segment
+	std::vector<double> loudnesses;
+	std::vector<double> pitches;
+	int n_bins;
+	// the n_bins - 1 edges between the bins, as difficulty and tie-breaker, indexed by (n_speakers - 2) * 3 + condition
+	typedef std::pair<double, double> Rank_t;
+	std::vector<std::vector<Rank_t> > bin_edges;
+
+	static int get_cell_index(int n_speakers, int icondition);
+};
+
+#endif
@@ -0,0 +1,43 @@
+/*
+ *  Brungart_tests.cpp
+ *  BrungartV3_device
+ *
+ */
+
+#include "Test_utilities.h"
+
+#include <iostream>
+#include <cstdlib>
+
+using namespace std;
+
+int n_test_failures = 0;
+
+// one for each module tested, in its own file
+void test_Condition_options();
+void test_Results_cube();
+void test_Results_cache();
+void test_Psychometric_estimator();
+void test_Parameter_race();
+void test_CRM_corpus();
+void test_Surrogate_evaluator();
+void test_Utterance_pair_index();
+
+int main()
+{
+	test_Condition_options();
+	test_Results_cube();
+	test_Results_cache();
+	test_Psychometric_estimator();
+	test_Parameter_race();
+	test_CRM_corpus();
+	test_Surrogate_evaluator();
+	test_Utterance_pair_index();
+
+	if(n_test_failures) {
+		cerr << n_test_failures << " checks failed" << endl;
+		return EXIT_FAILURE;
+		}
+	cout << "All checks passed" << endl;
+	return EXIT_SUCCESS;
+}
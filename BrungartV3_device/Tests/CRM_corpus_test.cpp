@@ -0,0 +1,83 @@
+/*
+ *  CRM_corpus_test.cpp
+ *  BrungartV3_device
+ *
+ */
+
+#include "Test_utilities.h"
+#include "CRM_corpus.h"
+#include "EPICLib/Device_exception.h"
+
+#include <vector>
+#include <string>
+#include <sstream>
+
+using namespace std;
+
+string get_synthetic_corpus(int n_talkers, int n_callsigns, int n_colors, int n_digits, unsigned long seed)
+{
+	vector<CRM_corpus::Voice> voices;
+	voices.push_back(CRM_corpus::Voice(120., 10., -5., 1.));
+	voices.push_back(CRM_corpus::Voice(220., 20., 5., 1.));
+	ostringstream oss;
+	CRM_corpus::write_synthetic(oss, n_talkers, n_callsigns, n_colors, n_digits, voices, seed);
+	return oss.str();
+}
+
+void test_CRM_corpus()
+{
+	// a corpus of any size is written with its dimensions line, and reads back at that size
+	string text = get_synthetic_corpus(3, 2, 5, 11, 7);
+	istringstream lines(text);
+	string line;
+	getline(lines, line);
+	CHECK(line == "synthetic 3x2x5x11 seed 7");
+	getline(lines, line);
+	CHECK(line == "dimensions 3 2 5 11");
+	istringstream iss(text);
+	CRM_corpus corpus;
+	corpus.load(iss, "synthetic");
+	CHECK(corpus.get_version_info() == "synthetic 3x2x5x11 seed 7");
+	CHECK(corpus.get_n_talkers() == 3 && corpus.get_n_callsigns() == 2 && corpus.get_n_colors() == 5 && corpus.get_n_digits() == 11);
+	CHECK(corpus.get_n_utterances() == 330);
+	CHECK(corpus.get_index(2, 1, 4, 10) == 329);
+	CHECK(corpus.get_utterance_id(2, 1, 4, 10) == 21410);
+
+	// each talker's segments are drawn from its voice, talker 2 reusing the first
+	double loudness_sums[3] = {0., 0., 0.};
+	for(int it = 0; it < 3; it++)
+		for(int ik = 0; ik < 5; ik++)
+			for(int id = 0; id < 11; id++)
+				for(int is = 0; is < n_utterance_segments; is++)
+					loudness_sums[it] += corpus.get(it, 0, ik, id).loudnesses[is];
+	CHECK_NEAR(loudness_sums[0] / (5 * 11 * n_utterance_segments), 55., 0.5);
+	CHECK_NEAR(loudness_sums[1] / (5 * 11 * n_utterance_segments), 65., 0.5);
+	CHECK_NEAR(loudness_sums[2] / (5 * 11 * n_utterance_segments), 55., 0.5);
+	CHECK(corpus.get(0, 0, 0, 0).pitches[0] < corpus.get(1, 0, 0, 0).pitches[0]);
+
+	// the same seed gives the same corpus
+	CHECK(get_synthetic_corpus(3, 2, 5, 11, 7) == text);
+	CHECK(get_synthetic_corpus(3, 2, 5, 11, 8) != text);
+
+	// without the dimensions line, the corpus is the published size
+	string standard_text = get_synthetic_corpus(8, 8, 4, 8, 1);
+	string::size_type dimensions_pos = standard_text.find("dimensions");
+	standard_text.erase(dimensions_pos, standard_text.find('\n', dimensions_pos) + 1 - dimensions_pos);
+	istringstream standard_iss(standard_text);
+	corpus.load(standard_iss, "standard");
+	CHECK(corpus.get_n_talkers() == 8 && corpus.get_n_colors() == 4 && corpus.get_n_utterances() == 2048);
+	CHECK(corpus.get_utterance_id(7, 6, 3, 5) == 7635);
+
+	// files that can't be used
+	CHECK_THROWS(corpus.load("no_such_corpus_file.txt"));
+	istringstream bad_dimensions("version\ndimensions 2 x 1 1\n");
+	CHECK_THROWS(corpus.load(bad_dimensions, "bad dimensions"));
+	istringstream zero_dimensions("version\ndimensions 2 0 1 1\n");
+	CHECK_THROWS(corpus.load(zero_dimensions, "zero dimensions"));
+	istringstream truncated(text.substr(0, text.size() / 2));
+	CHECK_THROWS(corpus.load(truncated, "truncated"));
+	string swapped = get_synthetic_corpus(1, 1, 1, 2, 3);
+	swapped.replace(swapped.find("0\t0\t0\t0"), 7, "0\t0\t0\t1");
+	istringstream out_of_order(swapped);
+	CHECK_THROWS(corpus.load(out_of_order, "out of order"));
+}
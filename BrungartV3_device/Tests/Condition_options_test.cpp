@@ -0,0 +1,120 @@
+/*
+ *  Condition_options_test.cpp
+ *  BrungartV3_device
+ *
+ */
+
+#include "Test_utilities.h"
+#include "Condition_options.h"
+#include "EPICLib/Device_exception.h"
+
+#include <string>
+
+using namespace std;
+
+// settings that are each fine alone but can't be combined
+const char * const excluded_combinations_c[] = {
+	"snr_placement=adaptive mode=surrogate",
+	"snr_placement=adaptive trials=TD:0:5",
+	"snr_placement=adaptive cache=c.txt model_seeding=trial",
+	"cache=c.txt",
+	"cache=c.txt model_seeding=shared",
+	"deadline=10 snr_placement=adaptive",
+	"deadline=10 mode=surrogate",
+	"deadline=10 cache=c.txt model_seeding=trial",
+	"deadline=10 replay=TD:0:1 seed=1",
+	"replay=TD:0:1",
+	"replay=TD:0:1 seed=1 fork_jobs=j.txt",
+	"replay=TD:0:1 seed=1 mode=surrogate",
+	"sampling=stratified snr_placement=adaptive",
+	"sampling=stratified mode=surrogate",
+	"race=r.txt deadline=10",
+	"race=r.txt cache=c.txt mode=surrogate",
+	"race=r.txt replay=TD:0:1 seed=1",
+	"race_start=4",
+	"merge=a.cube race=r.txt",
+	"merge=a.cube fork_jobs=j.txt",
+	"merge=a.cube cache=c.txt model_seeding=trial",
+	"merge=a.cube snr_placement=adaptive",
+	"trials=TD:1:5",
+	"snrs=0,-6 replay=TD:3:0 seed=1",
+};
+
+// values that are out of range or malformed
+const char * const incorrect_values_c[] = {
+	"speakers=5",
+	"speakers=2,x",
+	"conditions=TX",
+	"snrs=0,0",
+	"timeout=500",
+	"timeout=never",
+	"stall=0",
+	"stall=10:quit",
+	"sampling=stratified:1",
+	"sampling=stratified:17",
+	"ply=interval:0",
+	"trace=every:0",
+	"trace=cell:TX:0",
+	"model_seeding=none",
+	"race_start=1",
+	"merge=a.cube,,b.cube",
+	"seed=-",
+	"fork_max=0",
+	"nosuchoption=1",
+	"output",
+};
+
+void test_Condition_options()
+{
+	Condition_options options;
+	options.parse("20 2 rep");
+	CHECK(options.n_trials == 20);
+	CHECK(options.speaker_counts.size() == 1 && options.speaker_counts[0] == 2);
+	CHECK(options.conditions.size() == 3 && options.conditions[0] == 0 && options.conditions[2] == 2);
+	CHECK(options.snrs.size() == 10 && options.snrs.front() == -18. && options.snrs.back() == 9.);
+	CHECK(options.output_filename.empty() && options.corpus_spec.empty());
+	CHECK(!options.seed_specified && options.response_timeout == 0 && options.stall_seconds == 0.);
+	CHECK(options.trace_policy == Condition_options::TRACE_ALL && options.ply_policy == Condition_options::PLY_EACH);
+	options.parse("20 2 org");
+	CHECK(options.snrs.front() == -12. && options.snrs.back() == 15.);
+
+	options.parse("10 2 rep speakers=4,2,4 conditions=TT,TD snrs=3,-3 trials=TD:3:7 seed=12 timeout=default "
+		"stall=30:exit sampling=stratified ply=interval:250 trace=cell:TS:-3 race=r.txt");
+	CHECK(options.speaker_counts.size() == 2 && options.speaker_counts[0] == 4 && options.speaker_counts[1] == 2);
+	CHECK(options.conditions.size() == 2 && options.conditions[0] == 0 && options.conditions[1] == 2);
+	CHECK(options.snrs.size() == 2 && options.snrs[0] == 3. && options.snrs[1] == -3.);
+	CHECK(options.cell_trials.size() == 1 && options.cell_trials[0].condition_index == 0 && options.cell_trials[0].n_trials == 7);
+	CHECK(options.seed_specified && options.seed == 12);
+	CHECK(options.response_timeout == 2000);
+	CHECK(options.stall_seconds == 30. && options.stall_exit);
+	CHECK(options.stratify_bins == 4);
+	CHECK(options.ply_policy == Condition_options::PLY_INTERVAL && options.ply_interval == 250);
+	CHECK(options.trace_policy == Condition_options::TRACE_CELL && options.trace_condition == "TS" && options.trace_snr == -3.);
+	CHECK(options.race_start_trials == 2);
+
+	options.parse("20 3 rep snr_placement=adaptive");
+	CHECK(options.adaptive_snrs && options.snrs.size() == 43 && options.snrs.front() == -24. && options.snrs.back() == 18.);
+	options.parse("20 2 rep cache=c.txt model_seeding=trial");
+	CHECK(options.cache_filename == "c.txt" && options.seed_model_per_trial);
+	options.parse("20 2 rep cache=c.txt mode=surrogate");
+	CHECK(options.surrogate_mode);
+	options.parse("20 2 rep replay=TS:-6:3 seed=5 trace=errors");
+	CHECK(options.replay_mode && options.replay_cell.condition_index == 1 && options.replay_cell.n_trials == 3);
+	CHECK(options.trace_policy == Condition_options::TRACE_ALL);
+	options.parse("20 2 rep merge=a.cube,b.cube checkpoint=2");
+	CHECK(options.merge_filenames.size() == 2 && options.checkpoint_interval == 2);
+
+	for(size_t i = 0; i < sizeof(excluded_combinations_c) / sizeof(excluded_combinations_c[0]); i++)
+		CHECK_THROWS(options.parse(string("20 2 rep ") + excluded_combinations_c[i]));
+	for(size_t i = 0; i < sizeof(incorrect_values_c) / sizeof(incorrect_values_c[0]); i++)
+		CHECK_THROWS(options.parse(string("20 2 rep ") + incorrect_values_c[i]));
+	CHECK_THROWS(options.parse("0 2 rep"));
+	CHECK_THROWS(options.parse("20 1 rep"));
+	CHECK_THROWS(options.parse("20 2 new"));
+	CHECK_THROWS(options.parse("20 2"));
+
+	// an incorrect string leaves the settings as they were
+	options.parse("20 2 rep seed=7 output=kept.txt");
+	CHECK_THROWS(options.parse("30 3 org seed=8 output=lost.txt cache=c.txt"));
+	CHECK(options.n_trials == 20 && options.seed == 7 && options.output_filename == "kept.txt");
+}
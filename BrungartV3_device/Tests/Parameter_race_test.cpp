@@ -0,0 +1,108 @@
+/*
+ *  Parameter_race_test.cpp
+ *  BrungartV3_device
+ *
+ */
+
+#include "Test_utilities.h"
+#include "Parameter_race.h"
+#include "Results_cube.h"
+#include "EPICLib/Device_exception.h"
+
+#include <vector>
+#include <string>
+#include <fstream>
+#include <sstream>
+#include <cstdio>
+
+using namespace std;
+
+const char * const race_filename_c = "Parameter_race_test.txt";
+
+const char * const race_file_c =
+	"// observed both-correct proportions\n"
+	"data 2 TD 0 0.8\n"
+	"data 2 TS -6 0.5\n"
+	"candidate close\n"
+	"(Auditory_perceptual_processor Content_detection Color -18.0 10.0 0.04)\n"
+	"candidate exact\n"
+	"(Auditory_perceptual_processor Content_detection Color -20.0 10.0 0.04)\n"
+	"candidate far\n"
+	"(Auditory_perceptual_processor Content_detection Color -5.0 10.0 0.04)\n"
+	"candidate farther\n"
+	"(Auditory_perceptual_processor Content_detection Color 5.0 10.0 0.04)\n";
+
+void write_race_file(const string& contents)
+{
+	ofstream file(race_filename_c);
+	file << contents;
+}
+
+vector<string> get_condition_labels()
+{
+	vector<string> labels;
+	labels.push_back("TD");
+	labels.push_back("TS");
+	labels.push_back("TT");
+	return labels;
+}
+
+// give a candidate n trials in each data cell, with these numbers both correct
+void set_results(Parameter_race::Candidate& candidate, int n, int n_correct_TD, int n_correct_TS)
+{
+	vector<double> snrs = {-6., 0.};
+	candidate.results.reset(snrs);
+	candidate.results.add(2, 0, 1, Results_cube::outcome(0, 0), n_correct_TD);
+	candidate.results.add(2, 0, 1, Results_cube::outcome(2, 2), n - n_correct_TD);
+	candidate.results.add(2, 1, 0, Results_cube::outcome(0, 0), n_correct_TS);
+	candidate.results.add(2, 1, 0, Results_cube::outcome(1, 1), n - n_correct_TS);
+}
+
+void test_Parameter_race()
+{
+	vector<string> labels = get_condition_labels();
+	write_race_file(race_file_c);
+	Parameter_race race;
+	race.load(race_filename_c, labels);
+	CHECK(race.is_loaded() && race.get_n_candidates() == 4 && race.get_n_surviving() == 4);
+	CHECK(race.get_observations().size() == 2);
+	CHECK(race.has_observation(2, 1, -6.) && !race.has_observation(2, 1, 0.) && !race.has_observation(3, 0, 0.));
+	CHECK(race.get_candidate(1).name == "exact" && race.get_candidate(1).parameters.size() == 1);
+	CHECK(race.get_candidate(1).parameters[0].processor == "Auditory_perceptual_processor");
+	CHECK(race.get_candidate(1).parameters[0].spec == "Color -20.0 10.0 0.04");
+
+	// the clearly worse half is dropped, and the best is the leader
+	set_results(race.get_candidate(0), 100, 77, 53);
+	set_results(race.get_candidate(1), 100, 80, 50);
+	set_results(race.get_candidate(2), 100, 30, 95);
+	set_results(race.get_candidate(3), 100, 5, 100);
+	CHECK(race.eliminate() == 2);
+	CHECK(race.get_n_surviving() == 2 && race.get_candidate(0).surviving && race.get_candidate(1).surviving);
+	CHECK(race.get_leader() == 1);
+	CHECK(race.get_candidate(1).statistic < race.get_candidate(0).statistic);
+	CHECK(race.get_candidate(0).n_rounds == 1 && race.get_candidate(3).n_rounds == 1);
+	ostringstream standings;
+	race.write_standings(standings);
+	CHECK(standings.str().find("\nexact\tsurviving\t1\t") != string::npos);
+	CHECK(standings.str().find("\nfarther\tdropped\t1\t") != string::npos);
+
+	// a candidate that is worse, but not clearly so on the trials so far, survives the next round
+	set_results(race.get_candidate(0), 10, 6, 7);
+	set_results(race.get_candidate(1), 10, 8, 5);
+	CHECK(race.eliminate() == 0);
+	CHECK(race.get_n_surviving() == 2 && race.get_candidate(0).n_rounds == 2 && race.get_candidate(3).n_rounds == 1);
+
+	// files that can't be used
+	CHECK_THROWS(race.load("no_such_race_file.txt", labels));
+	write_race_file("data 2 TD 0 0.8\ncandidate only\n(P Content_detection Color 1 2 3)\n");
+	CHECK_THROWS(race.load(race_filename_c, labels));
+	write_race_file("data 2 TD 0 1.2\ncandidate a\ncandidate b\n");
+	CHECK_THROWS(race.load(race_filename_c, labels));
+	write_race_file("data 2 TX 0 0.8\ncandidate a\ncandidate b\n");
+	CHECK_THROWS(race.load(race_filename_c, labels));
+	write_race_file("data 2 TD 0 0.8\ncandidate a\n(P Content_detection Color 1 2 3)\ncandidate b\n(P Content_detection Digit 1 2 3)\n");
+	CHECK_THROWS(race.load(race_filename_c, labels));
+	write_race_file("data 2 TD 0 0.8\n(P Content_detection Color 1 2 3)\ncandidate a\ncandidate b\n");
+	CHECK_THROWS(race.load(race_filename_c, labels));
+	remove(race_filename_c);
+}
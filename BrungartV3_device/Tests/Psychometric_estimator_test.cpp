@@ -0,0 +1,50 @@
+/*
+ *  Psychometric_estimator_test.cpp
+ *  BrungartV3_device
+ *
+ */
+
+#include "Test_utilities.h"
+#include "Psychometric_estimator.h"
+
+#include <vector>
+#include <random>
+#include <cmath>
+
+using namespace std;
+
+// a simulated listener with a known psychometric function, on the grid the estimator uses
+const double true_threshold_c = -7.5;
+const double true_slope_c = 0.5;
+const double guess_rate_c = 1. / 32.;
+const double lapse_rate_c = 0.02;
+const int n_trials_c = 400;
+
+void test_Psychometric_estimator()
+{
+	vector<double> snrs;
+	for(double snr = -24.; snr <= 18.; snr += 1.)
+		snrs.push_back(snr);
+	Psychometric_estimator estimator(snrs, guess_rate_c, lapse_rate_c);
+	CHECK(estimator.get_n_trials() == 0);
+	// the uniform prior is centered on the candidates
+	CHECK_NEAR(estimator.get_threshold_mean(), -3., 1.e-6);
+	double prior_sd = estimator.get_threshold_sd();
+
+	mt19937 engine(1);
+	uniform_real_distribution<double> unit;
+	vector<int> n_at(snrs.size(), 0);
+	for(int trial = 0; trial < n_trials_c; trial++) {
+		int is = estimator.choose_stimulus();
+		CHECK(is >= 0 && is < int(snrs.size()));
+		double p = guess_rate_c + (1. - guess_rate_c - lapse_rate_c) / (1. + exp(-true_slope_c * (snrs[is] - true_threshold_c)));
+		estimator.update(is, unit(engine) < p);
+		n_at[is]++;
+		}
+	CHECK(estimator.get_n_trials() == n_trials_c);
+	CHECK_NEAR(estimator.get_threshold_mean(), true_threshold_c, 1.5);
+	CHECK(estimator.get_threshold_sd() < 1. && estimator.get_threshold_sd() < prior_sd / 10.);
+	CHECK(estimator.get_slope_mean() > true_slope_c / 2. && estimator.get_slope_mean() < true_slope_c * 2.);
+	// the trials go where they tell most about the function, not to the extremes
+	CHECK(n_at.front() + n_at.back() < n_trials_c / 10);
+}
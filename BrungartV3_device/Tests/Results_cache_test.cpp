@@ -0,0 +1,63 @@
+/*
+ *  Results_cache_test.cpp
+ *  BrungartV3_device
+ *
+ */
+
+#include "Test_utilities.h"
+#include "Results_cache.h"
+
+#include <vector>
+#include <fstream>
+#include <cstdio>
+
+using namespace std;
+
+const char * const cache_filename_c = "Results_cache_test.cache";
+
+void test_Results_cache()
+{
+	// FNV-1a, and chained calls hash the inputs as one
+	CHECK(Results_cache::hash("") == Results_cache::hash_basis_c);
+	CHECK(Results_cache::hash("a") == 0xaf63dc4c8601ec8cULL);
+	CHECK(Results_cache::hash("b", Results_cache::hash("a")) == Results_cache::hash("ab"));
+
+	remove(cache_filename_c);
+	uint64_t key = Results_cache::hash("TD 0");
+	uint64_t other_key = Results_cache::hash("TD -6");
+	vector<double> values = {1., 0.1, 1. / 3., 0.};
+	vector<double> found;
+	{
+		Results_cache cache;
+		CHECK(cache.open(cache_filename_c));
+		CHECK(cache.get_n_entries() == 0);
+		CHECK(!cache.lookup(key, found));
+		CHECK(cache.store(key, values));
+		CHECK(cache.lookup(key, found) && found == values);
+		CHECK(!cache.lookup(other_key, found));
+	}
+	// a line cut short is skipped
+	{
+		ofstream file(cache_filename_c, ios::app);
+		file << "00000000000000ff 3 1.5";
+	}
+	// the entries are read back exactly from the file, and a later entry for a key replaces an earlier one
+	{
+		Results_cache cache;
+		CHECK(cache.open(cache_filename_c));
+		CHECK(cache.get_n_entries() == 1);
+		CHECK(cache.lookup(key, found) && found == values);
+		CHECK(!cache.lookup(0xff, found));
+		vector<double> new_values(2, 7.);
+		CHECK(cache.store(key, new_values));
+		CHECK(cache.store(other_key, vector<double>()));
+	}
+	{
+		Results_cache cache;
+		CHECK(cache.open(cache_filename_c));
+		CHECK(cache.get_n_entries() == 2);
+		CHECK(cache.lookup(key, found) && found == vector<double>(2, 7.));
+		CHECK(cache.lookup(other_key, found) && found.empty());
+	}
+	remove(cache_filename_c);
+}
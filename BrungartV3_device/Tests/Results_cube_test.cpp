@@ -0,0 +1,57 @@
+/*
+ *  Results_cube_test.cpp
+ *  BrungartV3_device
+ *
+ */
+
+#include "Test_utilities.h"
+#include "Results_cube.h"
+
+#include <vector>
+#include <sstream>
+
+using namespace std;
+
+void test_Results_cube()
+{
+	vector<double> snrs = {-6., 0., 3.};
+	Results_cube cube;
+	cube.reset(snrs);
+	cube.add(2, 0, 1, Results_cube::outcome(0, 0), 5.);
+	cube.add(2, 0, 1, Results_cube::outcome(1, 2));
+	cube.add(4, 2, 2, Results_cube::timeout_outcome_c, 2.);
+	cube.add(3, 1, 0, Results_cube::outcome(2, 1), 0.25);
+	CHECK(cube.get_n_trials(2, 0, 1) == 6.);
+	CHECK(cube.get_n_timeouts(4, 2, 2) == 2. && cube.get_n_trials(4, 2, 2) == 2.);
+	double table[3][3];
+	cube.get_table(2, 0, 1, table);
+	CHECK(table[0][0] == 5. && table[1][2] == 1. && table[2][1] == 0.);
+
+	// the binary form gives back the same SNRs and counts
+	stringstream ss;
+	cube.write_binary(ss);
+	Results_cube copy;
+	CHECK(copy.read_binary(ss));
+	CHECK(copy.get_n_snrs() == 3 && copy.get_snr(0) == -6. && copy.get_snr(2) == 3.);
+	CHECK(copy.get(2, 0, 1, Results_cube::outcome(0, 0)) == 5.);
+	CHECK(copy.get(3, 1, 0, Results_cube::outcome(2, 1)) == 0.25);
+	CHECK(copy.get_n_timeouts(4, 2, 2) == 2.);
+
+	// cubes of the same shape add; others are refused and left alone
+	CHECK(copy.accumulate(cube));
+	CHECK(copy.get(2, 0, 1, Results_cube::outcome(0, 0)) == 10. && copy.get_n_trials(2, 0, 1) == 12.);
+	CHECK(copy.get_n_timeouts(4, 2, 2) == 4.);
+	Results_cube other;
+	other.reset(vector<double>(1, 0.));
+	CHECK(!copy.accumulate(other));
+	CHECK(copy.get_n_trials(2, 0, 1) == 12.);
+	copy.clear();
+	CHECK(copy.get_n_trials(2, 0, 1) == 0. && copy.get_n_snrs() == 3);
+
+	// a stream that isn't a whole cube is refused
+	string bytes = ss.str();
+	istringstream truncated(bytes.substr(0, bytes.size() - 8));
+	CHECK(!copy.read_binary(truncated));
+	istringstream not_a_cube("BRCUBE0\n and the rest");
+	CHECK(!copy.read_binary(not_a_cube));
+}
@@ -0,0 +1,124 @@
+/*
+ *  Surrogate_evaluator_test.cpp
+ *  BrungartV3_device
+ *
+ */
+
+#include "Test_utilities.h"
+#include "Surrogate_evaluator.h"
+#include "Message.h"
+#include "CRM_utterance_stats.h"
+#include "EPICLib/Device_exception.h"
+#include "EPICLib/Symbol.h"
+
+#include <vector>
+#include <string>
+#include <fstream>
+#include <cstdio>
+
+using namespace std;
+
+const char * const prs_filename_c = "Surrogate_evaluator_test.prs";
+const int n_colors_c = 4;
+const int n_digits_c = 8;
+const int n_batch_trials_c = 10;
+
+// a message whose every segment has this loudness and pitch; no device is needed to evaluate it
+Message make_message(int talker, double loudness, double pitch)
+{
+	CRM_utterance_stats stats;
+	stats.duration = 1.8;
+	for(int i = 0; i < n_utterance_segments; i++) {
+		stats.loudnesses[i] = loudness;
+		stats.pitches[i] = pitch;
+		}
+	return Message(nullptr, Symbol("Stream"), Symbol("Male"), Symbol("Talker"), talker, 0, talker, talker, 0, stats, 0.,
+		Symbol("Baron"), Symbol("Blue"), Symbol("One"));
+}
+
+// the expected contingency table for a batch of identical trials of a target and a masker
+void evaluate_pair(const Surrogate_parameters& parameters, const Message& target, const Message& masker, double table[3][3])
+{
+	Surrogate_evaluator evaluator(parameters, n_colors_c, n_digits_c);
+	vector<Message> messages;
+	messages.push_back(target);
+	messages.push_back(masker);
+	for(int i = 0; i < n_batch_trials_c; i++)
+		evaluator.add_trial(messages, 2);
+	for(int icr = 0; icr < 3; icr++)
+		for(int idr = 0; idr < 3; idr++)
+			table[icr][idr] = 0.;
+	evaluator.evaluate(table);
+}
+
+double get_total(const double table[3][3])
+{
+	double total = 0.;
+	for(int icr = 0; icr < 3; icr++)
+		for(int idr = 0; idr < 3; idr++)
+			total += table[icr][idr];
+	return total;
+}
+
+void test_Surrogate_evaluator()
+{
+	// parameters from a .prs file, ignoring what is commented out, with Nil supplying the unspecified categories
+	{
+		ofstream prs_file(prs_filename_c);
+		prs_file << "(Define Parameters\n"
+			"(Auditory_perceptual_processor Content_detection Nil -15.0 8.0 0.0)\n"
+			"(Auditory_perceptual_processor Content_detection Color -18.0 10.0 0.04)\n"
+			"//(Auditory_perceptual_processor Content_detection Digit -5.0 1.0 0.5)\n"
+			"(Auditory_perceptual_processor Stream_theta Value 2.5)\n"
+			"(Auditory_perceptual_processor Effective_snr_pitch_weight Value 0.5)\n"
+			"(Visual_perceptual_processor Stream_theta Value 9.0)\n"
+			")\n";
+	}
+	Surrogate_parameters loaded;
+	loaded.load_from_prs_file(prs_filename_c);
+	CHECK(loaded.color.mean == -18. && loaded.color.sd == 10. && loaded.color.lapse == 0.04);
+	CHECK(loaded.callsign.mean == -15. && loaded.digit.mean == -15. && loaded.digit.sd == 8.);
+	CHECK(loaded.stream_theta == 2.5 && loaded.pitch_weight == 0.5 && loaded.loudness_weight == 1.);
+	{
+		ofstream prs_file(prs_filename_c);
+		prs_file << "(Auditory_perceptual_processor Content_detection Color -18.0 0.0 0.04)\n";
+	}
+	CHECK_THROWS(loaded.load_from_prs_file(prs_filename_c));
+	remove(prs_filename_c);
+	CHECK_THROWS(loaded.load_from_prs_file("no_such_file.prs"));
+
+	Surrogate_parameters parameters;
+	parameters.stream_pitch_weight = 1.;
+	parameters.stream_theta = 1.;
+	double table[3][3];
+
+	// every trial contributes one response, and evaluating empties the batch
+	Surrogate_evaluator evaluator(parameters, n_colors_c, n_digits_c);
+	vector<Message> messages;
+	messages.push_back(make_message(0, 60., 50.));
+	messages.push_back(make_message(1, 60., 60.));
+	messages.push_back(make_message(2, 60., 70.));
+	for(int i = 0; i < n_batch_trials_c; i++)
+		evaluator.add_trial(messages, 1 + i % 3);
+	for(int icr = 0; icr < 3; icr++)
+		for(int idr = 0; idr < 3; idr++)
+			table[icr][idr] = 0.;
+	evaluator.evaluate(table);
+	CHECK_NEAR(get_total(table), n_batch_trials_c, 1e-9);
+	evaluator.evaluate(table);
+	CHECK_NEAR(get_total(table), n_batch_trials_c, 1e-9);
+
+	// a much louder target is almost always reported, a much quieter one almost never
+	evaluate_pair(parameters, make_message(0, 90., 50.), make_message(1, 60., 60.), table);
+	CHECK_NEAR(get_total(table), n_batch_trials_c, 1e-9);
+	CHECK(table[0][0] > 0.99 * n_batch_trials_c);
+	evaluate_pair(parameters, make_message(0, 30., 50.), make_message(1, 80., 60.), table);
+	CHECK(table[0][0] < 0.01 * n_batch_trials_c && table[1][1] > 0.5 * n_batch_trials_c);
+
+	// at the same level, a masker in the target's own voice captures the target stream more often
+	double different_voice[3][3], same_voice[3][3];
+	evaluate_pair(parameters, make_message(0, 60., 50.), make_message(1, 60., 60.), different_voice);
+	evaluate_pair(parameters, make_message(0, 60., 50.), make_message(0, 60., 50.), same_voice);
+	CHECK(same_voice[0][0] < different_voice[0][0] - 0.1 * n_batch_trials_c);
+	CHECK(same_voice[1][1] > different_voice[1][1]);
+}
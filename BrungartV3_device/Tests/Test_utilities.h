@@ -0,0 +1,41 @@
+/*
+ *  Test_utilities.h
+ *  BrungartV3_device
+ *
+ */
+
+#ifndef TEST_UTILITIES_H
+#define TEST_UTILITIES_H
+
+#include <iostream>
+#include <cmath>
+
+/*
+The checks for the module tests. A failed check is reported with its file and line and counted, and the tests
+carry on, so one run shows every failure; the test program exits with a failure status if any check failed.
+*/
+extern int n_test_failures;
+
+#define CHECK(condition) \
+	do { \
+		if(!(condition)) { \
+			std::cerr << __FILE__ << ":" << __LINE__ << ": check failed: " << #condition << std::endl; \
+			n_test_failures++; \
+			} \
+	} while(0)
+
+#define CHECK_NEAR(value, expected, tolerance) CHECK(std::fabs((value) - (expected)) <= (tolerance))
+
+// the statement must throw a Device_exception
+#define CHECK_THROWS(statement) \
+	do { \
+		bool thrown = false; \
+		try {statement;} \
+		catch(Device_exception&) {thrown = true;} \
+		if(!thrown) { \
+			std::cerr << __FILE__ << ":" << __LINE__ << ": no exception from: " << #statement << std::endl; \
+			n_test_failures++; \
+			} \
+	} while(0)
+
+#endif
@@ -0,0 +1,102 @@
+/*
+ *  Utterance_pair_index_test.cpp
+ *  BrungartV3_device
+ *
+ */
+
+#include "Test_utilities.h"
+#include "Utterance_pair_index.h"
+#include "CRM_corpus.h"
+#include "Surrogate_evaluator.h"
+
+#include <vector>
+#include <sstream>
+#include <random>
+#include <algorithm>
+
+using namespace std;
+
+const int n_bins_c = 4;
+const int n_stimuli_c = 4000;
+
+// the number of each bin among n stimuli drawn from the uniform random pairs of different talkers
+void count_bins(const Utterance_pair_index& index, mt19937& engine, int n, int counts[n_bins_c])
+{
+	uniform_int_distribution<int> talker(0, 7), callsign(0, 7), color(0, 3), digit(0, 7);
+	for(int ib = 0; ib < n_bins_c; ib++)
+		counts[ib] = 0;
+	for(int i = 0; i < n; i++) {
+		int talkers[2] = {talker(engine), talker(engine)};
+		int callsigns[2] = {callsign(engine), callsign(engine)};
+		int colors[2] = {color(engine), color(engine)};
+		int digits[2] = {digit(engine), digit(engine)};
+		counts[index.get_bin(2, 0, index.get_difficulty(talkers, callsigns, colors, digits, 2), engine)]++;
+		}
+}
+
+void test_Utterance_pair_index()
+{
+	// the even talkers are quieter than the odd ones
+	vector<CRM_corpus::Voice> voices;
+	voices.push_back(CRM_corpus::Voice(120., 10., -5., 2.));
+	voices.push_back(CRM_corpus::Voice(220., 20., 5., 2.));
+	stringstream ss;
+	CRM_corpus::write_synthetic(ss, 8, 8, 4, 8, voices, 11);
+	CRM_corpus corpus;
+	corpus.load(ss, "synthetic");
+	Surrogate_parameters parameters;
+	Utterance_pair_index index;
+	index.load(parameters, corpus);
+	CHECK(index.get_n_bins() == 0);
+
+	// the difficulty is the target's level over its strongest masker, averaged over the color and digit segments
+	int talkers[3] = {1, 0, 3}, callsigns[3] = {0, 1, 2}, colors[3] = {0, 1, 2}, digits[3] = {0, 1, 2};
+	const CRM_utterance_stats& target = corpus.get(1, 0, 0, 0);
+	const CRM_utterance_stats& masker = corpus.get(0, 1, 1, 1);
+	const CRM_utterance_stats& loud_masker = corpus.get(3, 2, 2, 2);
+	double expected = (target.loudnesses[3] - masker.loudnesses[3] + target.loudnesses[4] - masker.loudnesses[4]) / 2.;
+	CHECK_NEAR(index.get_difficulty(talkers, callsigns, colors, digits, 2), expected, 1e-9);
+	CHECK(expected > 0.);
+	double lowest[2];
+	for(int is = 0; is < 2; is++)
+		lowest[is] = min(target.loudnesses[3 + is] - masker.loudnesses[3 + is], target.loudnesses[3 + is] - loud_masker.loudnesses[3 + is]);
+	CHECK_NEAR(index.get_difficulty(talkers, callsigns, colors, digits, 3), (lowest[0] + lowest[1]) / 2., 1e-9);
+	talkers[0] = 0;
+	talkers[1] = 1;
+	CHECK(index.get_difficulty(talkers, callsigns, colors, digits, 2) < 0.);
+	talkers[1] = 0;
+	callsigns[1] = callsigns[0];
+	colors[1] = colors[0];
+	digits[1] = digits[0];
+	CHECK(index.get_difficulty(talkers, callsigns, colors, digits, 2) == 0.);
+
+	// the bins each hold an equal share of the stimuli drawn the usual way
+	mt19937 engine(5);
+	vector<double> sample;
+	uniform_int_distribution<int> talker(0, 7), callsign(0, 7), color(0, 3), digit(0, 7);
+	for(int i = 0; i < n_stimuli_c; i++) {
+		int sample_talkers[2] = {talker(engine), talker(engine)};
+		int sample_callsigns[2] = {callsign(engine), callsign(engine)};
+		int sample_colors[2] = {color(engine), color(engine)};
+		int sample_digits[2] = {digit(engine), digit(engine)};
+		sample.push_back(index.get_difficulty(sample_talkers, sample_callsigns, sample_colors, sample_digits, 2));
+		}
+	index.set_bins(2, 0, sample, n_bins_c, engine);
+	CHECK(index.get_n_bins() == n_bins_c);
+	int counts[n_bins_c];
+	count_bins(index, engine, n_stimuli_c, counts);
+	for(int ib = 0; ib < n_bins_c; ib++)
+		CHECK_NEAR(counts[ib], n_stimuli_c / n_bins_c, n_stimuli_c / n_bins_c / 10);
+	CHECK(index.get_bin(2, 0, -100., engine) == 0);
+	CHECK(index.get_bin(2, 0, 100., engine) == n_bins_c - 1);
+
+	// stimuli of the same difficulty are spread equally over the bins by the tie-breakers
+	index.set_bins(3, 2, vector<double>(n_stimuli_c, 0.), n_bins_c, engine);
+	for(int ib = 0; ib < n_bins_c; ib++)
+		counts[ib] = 0;
+	for(int i = 0; i < n_stimuli_c; i++)
+		counts[index.get_bin(3, 2, 0., engine)]++;
+	for(int ib = 0; ib < n_bins_c; ib++)
+		CHECK_NEAR(counts[ib], n_stimuli_c / n_bins_c, n_stimuli_c / n_bins_c / 10);
+	CHECK(index.get_bin(3, 2, -0.1, engine) == 0 && index.get_bin(3, 2, 0.1, engine) == n_bins_c - 1);
+}